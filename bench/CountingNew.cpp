@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "Engine/HeapCounter.hpp"
+
+// replaces the global operator new and delete for the checks that measure
+// allocations; the game links the default ones
+
+namespace {
+    auto allocate(size_t size) -> void * {
+        SDLEngine::countThreadAllocation();
+        size = size == 0 ? 1 : size;
+        for (;;) {
+            if (auto data = std::malloc(size)) {
+                return data;
+            }
+            auto handler = std::get_new_handler();
+            if (handler == nullptr) {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+
+    auto allocateAligned(size_t size, std::align_val_t alignment) -> void * {
+        SDLEngine::countThreadAllocation();
+        auto align = static_cast<size_t>(alignment);
+        size       = (std::max<size_t>(size, 1) + align - 1) & ~(align - 1);
+        for (;;) {
+#if defined(_MSC_VER)
+            auto data = _aligned_malloc(size, align);
+#else
+            auto data = std::aligned_alloc(align, size);
+#endif
+            if (data != nullptr) {
+                return data;
+            }
+            auto handler = std::get_new_handler();
+            if (handler == nullptr) {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+
+    auto freeAligned(void *data) -> void {
+#if defined(_MSC_VER)
+        _aligned_free(data);
+#else
+        std::free(data);
+#endif
+    }
+}
+
+// the array and nothrow forms forward to these by default
+
+auto operator new(size_t size) -> void * {
+    return allocate(size);
+}
+
+auto operator delete(void *data) noexcept -> void {
+    std::free(data);
+}
+
+auto operator delete(void *data, size_t) noexcept -> void {
+    std::free(data);
+}
+
+auto operator new(size_t size, std::align_val_t alignment) -> void * {
+    return allocateAligned(size, alignment);
+}
+
+auto operator delete(void *data, std::align_val_t) noexcept -> void {
+    freeAligned(data);
+}
+
+auto operator delete(void *data, size_t, std::align_val_t) noexcept -> void {
+    freeAligned(data);
+}
@@ -0,0 +1,218 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "View/Heightfield.h"
+#include "View/MeshExport.h"
+#include "View/MeshSimplifier.h"
+
+namespace {
+    // a mesh as read back from an exported file
+    struct Mesh {
+        std::vector<float> positions;
+        std::vector<uint32_t> indices;
+    };
+
+    std::vector<char> readFile(const std::string &path) {
+        std::ifstream infile(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(infile),
+                                 std::istreambuf_iterator<char>());
+    }
+
+    uint32_t u32At(const std::vector<char> &data, size_t offset) {
+        uint32_t value = 0;
+        for (int i = 3; i >= 0; i--) {
+            value = value << 8 | static_cast<unsigned char>(data[offset + i]);
+        }
+        return value;
+    }
+
+    float f32At(const std::vector<char> &data, size_t offset) {
+        auto bits = u32At(data, offset);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    Mesh readObj(const std::string &path) {
+        Mesh mesh;
+        std::ifstream infile(path);
+        std::string line;
+        while (std::getline(infile, line)) {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            if (kind == "v") {
+                float x, y, z;
+                fields >> x >> y >> z;
+                mesh.positions.insert(mesh.positions.end(), {x, y, z});
+            } else if (kind == "f") {
+                uint32_t i, j, k;
+                fields >> i >> j >> k;
+                mesh.indices.insert(mesh.indices.end(), {i - 1, j - 1, k - 1});
+            }
+        }
+        return mesh;
+    }
+
+    Mesh readPly(const std::string &path) {
+        Mesh mesh;
+        auto data   = readFile(path);
+        auto header = std::string(data.begin(), data.end());
+        auto end    = header.find("end_header\n");
+        if (end == std::string::npos) {
+            return mesh;
+        }
+        unsigned long long vertices = 0, faces = 0;
+        std::sscanf(header.c_str() + header.find("element vertex"),
+                    "element vertex %llu", &vertices);
+        std::sscanf(header.c_str() + header.find("element face"),
+                    "element face %llu", &faces);
+        auto offset = end + std::strlen("end_header\n");
+        for (unsigned long long i = 0; i < vertices * 3; i++, offset += 4) {
+            mesh.positions.push_back(f32At(data, offset));
+        }
+        for (unsigned long long i = 0; i < faces; i++) {
+            offset += 1;
+            for (int corner = 0; corner < 3; corner++, offset += 4) {
+                mesh.indices.push_back(u32At(data, offset));
+            }
+        }
+        return mesh;
+    }
+
+    Mesh readGlb(const std::string &path) {
+        Mesh mesh;
+        auto data = readFile(path);
+        if (data.size() < 20) {
+            return mesh;
+        }
+        auto jsonBytes = u32At(data, 12);
+        auto json      = std::string(data.begin() + 20,
+                                     data.begin() + 20 + jsonBytes);
+        // the positions accessor comes first, then the indices accessor
+        auto first    = json.find("\"count\":");
+        auto second   = json.find("\"count\":", first + 1);
+        auto vertices = std::stoull(json.substr(first + 8));
+        auto indices  = std::stoull(json.substr(second + 8));
+        auto offset   = 20 + jsonBytes + 8;
+        for (unsigned long long i = 0; i < vertices * 3; i++, offset += 4) {
+            mesh.positions.push_back(f32At(data, offset));
+        }
+        for (unsigned long long i = 0; i < indices; i++, offset += 4) {
+            mesh.indices.push_back(u32At(data, offset));
+        }
+        return mesh;
+    }
+
+    // every face of a heightfield must face up, the first one included
+    bool facesUp(const char *name, const Mesh &mesh) {
+        if (mesh.indices.empty()) {
+            std::printf("%-24s no faces read\n", name);
+            return false;
+        }
+        size_t down = 0;
+        auto firstY = 0.f;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            auto a = &mesh.positions[mesh.indices[i] * 3];
+            auto b = &mesh.positions[mesh.indices[i + 1] * 3];
+            auto c = &mesh.positions[mesh.indices[i + 2] * 3];
+            // y of (b - a) x (c - a)
+            auto y = (b[2] - a[2]) * (c[0] - a[0]) -
+                     (b[0] - a[0]) * (c[2] - a[2]);
+            if (i == 0) {
+                firstY = y;
+            }
+            down += y > 0.f ? 0 : 1;
+        }
+        std::printf("%-24s %6zu faces, first normal y %.3f, %zu facing down  "
+                    "%s\n",
+                    name, mesh.indices.size() / 3, firstY, down,
+                    down == 0 ? "ok" : "FAILED");
+        return down == 0;
+    }
+
+    template <typename Write>
+    bool checkFormats(const char *name, Write &&write) {
+        auto ok = true;
+        for (auto extension : {"obj", "ply", "glb"}) {
+            auto path = std::string("MeshExportCheck.") + extension;
+            MeshExport::Format format;
+            MeshExport::formatFromPath(path, format);
+            MeshExport::Stats stats;
+            if (!write(path, format, stats)) {
+                std::printf("%s %s: export failed\n", name, extension);
+                ok = false;
+                continue;
+            }
+            auto mesh  = format == MeshExport::Format::Obj ? readObj(path)
+                         : format == MeshExport::Format::Ply ? readPly(path)
+                                                              : readGlb(path);
+            auto label = std::string(name) + " " + extension;
+            ok         = facesUp(label.c_str(), mesh) && ok;
+            std::remove(path.c_str());
+        }
+        return ok;
+    }
+}
+
+int main() {
+    constexpr int size = 65;
+    std::vector<float> heights(static_cast<size_t>(size) * size);
+    for (int z = 0; z < size; z++) {
+        for (int x = 0; x < size; x++) {
+            heights[static_cast<size_t>(z) * size + x] =
+                20.f * std::sin(x * 0.2f) * std::cos(z * 0.15f);
+        }
+    }
+    Heightfield field;
+    field.assign(heights.data(), size);
+
+    auto ok = checkFormats("grid", [&](const std::string &path,
+                                       MeshExport::Format format,
+                                       MeshExport::Stats &stats) {
+        auto rows = [&](int z, float *out) { field.readRow(z, 0, size, out); };
+        return MeshExport::writeHeightfield(path, format, size, rows, 1.f, 1.f,
+                                            1.f, stats);
+    });
+
+    // the simplified mesh, indexed by grid sample like Terrain does
+    MeshSimplifier simplifier;
+    std::vector<MeshSimplifier::Triangle> triangles;
+    simplifier.build(field);
+    simplifier.extract(0.5f, triangles);
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> remap(heights.size(), ~uint32_t{0});
+    auto vertex = [&](int x, int z) {
+        auto &index = remap[static_cast<size_t>(z) * size + x];
+        if (index == ~uint32_t{0}) {
+            index = static_cast<uint32_t>(positions.size() / 3);
+            positions.insert(positions.end(),
+                             {static_cast<float>(x), field.get(x, z),
+                              static_cast<float>(z)});
+        }
+        return index;
+    };
+    for (const auto &tri : triangles) {
+        indices.insert(indices.end(), {vertex(tri.ax, tri.az),
+                                       vertex(tri.bx, tri.bz),
+                                       vertex(tri.cx, tri.cz)});
+    }
+    ok = checkFormats("simplified", [&](const std::string &path,
+                                        MeshExport::Format format,
+                                        MeshExport::Stats &stats) {
+        return MeshExport::writeIndexed(path, format, positions.data(),
+                                        positions.size() / 3, indices.data(),
+                                        indices.size() / 3, stats);
+    }) && ok;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
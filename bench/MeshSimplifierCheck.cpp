@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "View/Heightfield.h"
+#include "View/MeshSimplifier.h"
+
+// the simplified mesh must cover the grid exactly once, share every interior
+// edge between exactly two triangles and stay within the error bound at
+// every sample
+
+namespace {
+    // float slack on top of the requested bound for the plane evaluation
+    constexpr float ERROR_SLACK = 1e-3f;
+
+    Heightfield makeField(int size, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> noise(-1.f, 1.f);
+        std::vector<float> heights(static_cast<size_t>(size) * size);
+        for (int z = 0; z < size; z++) {
+            for (int x = 0; x < size; x++) {
+                heights[static_cast<size_t>(z) * size + x] =
+                    30.f * std::sin(x * 0.11f) * std::cos(z * 0.07f) +
+                    8.f * std::sin((x + z) * 0.31f) + noise(rng);
+            }
+        }
+        Heightfield field;
+        field.assign(heights.data(), size);
+        return field;
+    }
+
+    bool check(int size, float maxError) {
+        auto field = makeField(size, static_cast<unsigned>(size));
+        MeshSimplifier simplifier;
+        std::vector<MeshSimplifier::Triangle> triangles;
+        simplifier.build(field);
+        simplifier.extract(maxError, triangles);
+
+        // twice the signed area, negative when counter-clockwise from +y
+        int64_t area   = 0;
+        size_t flipped = 0;
+        std::unordered_map<uint64_t, int> edges;
+        auto vertexId = [&](int x, int z) {
+            return static_cast<uint64_t>(z) * size + x;
+        };
+        auto addEdge = [&](uint64_t a, uint64_t b) {
+            ++edges[std::min(a, b) << 32 | std::max(a, b)];
+        };
+        auto worst = 0.f;
+        for (const auto &tri : triangles) {
+            int64_t twice = static_cast<int64_t>(tri.bx - tri.ax) * (tri.cz - tri.az) -
+                            static_cast<int64_t>(tri.bz - tri.az) * (tri.cx - tri.ax);
+            area += twice;
+            flipped += twice < 0 ? 0 : 1;
+            auto a = vertexId(tri.ax, tri.az);
+            auto b = vertexId(tri.bx, tri.bz);
+            auto c = vertexId(tri.cx, tri.cz);
+            addEdge(a, b);
+            addEdge(b, c);
+            addEdge(c, a);
+
+            // compare the triangle's plane with every sample inside it
+            if (twice == 0) {
+                continue;
+            }
+            auto ha = field.get(tri.ax, tri.az);
+            auto hb = field.get(tri.bx, tri.bz);
+            auto hc = field.get(tri.cx, tri.cz);
+            for (int z = std::min({tri.az, tri.bz, tri.cz});
+                 z <= std::max({tri.az, tri.bz, tri.cz}); z++) {
+                for (int x = std::min({tri.ax, tri.bx, tri.cx});
+                     x <= std::max({tri.ax, tri.bx, tri.cx}); x++) {
+                    auto wa = static_cast<int64_t>(tri.bx - x) * (tri.cz - z) -
+                              static_cast<int64_t>(tri.bz - z) * (tri.cx - x);
+                    auto wb = static_cast<int64_t>(tri.cx - x) * (tri.az - z) -
+                              static_cast<int64_t>(tri.cz - z) * (tri.ax - x);
+                    auto wc = twice - wa - wb;
+                    auto inside = twice < 0 ? wa <= 0 && wb <= 0 && wc <= 0
+                                            : wa >= 0 && wb >= 0 && wc >= 0;
+                    if (!inside) {
+                        continue;
+                    }
+                    auto plane = (wa * ha + wb * hb + wc * hc) /
+                                 static_cast<float>(twice);
+                    worst = std::max(worst, std::fabs(plane - field.get(x, z)));
+                }
+            }
+        }
+
+        // an edge along the border belongs to one triangle, any other to two
+        size_t badEdges = 0;
+        for (const auto &edge : edges) {
+            auto a       = edge.first >> 32;
+            auto b       = edge.first & 0xffffffffu;
+            auto ax      = static_cast<int>(a % size);
+            auto az      = static_cast<int>(a / size);
+            auto bx      = static_cast<int>(b % size);
+            auto bz      = static_cast<int>(b / size);
+            auto last    = size - 1;
+            auto border  = (ax == bx && (ax == 0 || ax == last)) ||
+                          (az == bz && (az == 0 || az == last));
+            badEdges += edge.second == (border ? 1 : 2) ? 0 : 1;
+        }
+
+        auto gridArea = 2 * static_cast<int64_t>(size - 1) * (size - 1);
+        auto ok       = -area == gridArea && flipped == 0 && badEdges == 0 &&
+                  worst <= maxError + ERROR_SLACK;
+        std::printf("size %4d  error %5.2f  %7zu triangles  area %s  "
+                    "%zu flipped  %zu bad edges  worst %.4f  %s\n",
+                    size, maxError, triangles.size(),
+                    -area == gridArea ? "ok" : "WRONG", flipped, badEdges,
+                    worst, ok ? "ok" : "FAILED");
+        return ok;
+    }
+}
+
+int main() {
+    auto ok = true;
+    for (auto size : {2, 17, 33, 100, 129, 200, 257}) {
+        for (auto maxError : {0.f, 0.5f, 2.f, 10.f}) {
+            ok = check(size, maxError) && ok;
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
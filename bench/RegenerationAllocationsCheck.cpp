@@ -0,0 +1,52 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "Engine/HeapCounter.hpp"
+#include "View/Terrain.h"
+
+// rebuilding the terrain at unchanged settings must not touch the heap once
+// every per-build buffer has been sized by the first build
+
+namespace {
+    void regenerate(Terrain &terrain) {
+        srand(1);
+        terrain.genFaultFormation(64, 128, 0, 255, 0.5f, 1, false);
+        // turning baked lighting off clears the lightmap without releasing
+        // its planes, so the next build rebakes into them
+        terrain.setBakedLighting(false);
+        terrain.setBakedLighting(true);
+        terrain.createTriangles();
+    }
+
+    bool check(const char *name, float maxMeshError) {
+        Terrain terrain;
+        terrain.setMaxMeshError(maxMeshError);
+        terrain.setBakedLighting(true);
+        terrain.setSplatting(true);
+        Scatter::Parameters trees;
+        trees.density = 0.6f;
+        terrain.addScatter(trees);
+        Scatter::Parameters rocks;
+        rocks.shape = Scatter::Shape::Rock;
+        rocks.seed  = 2;
+        terrain.addScatter(rocks);
+
+        // the first build must count something, or operator new isn't the
+        // counting one and a zero below would mean nothing
+        auto first = SDLEngine::threadAllocations();
+        regenerate(terrain);
+        auto before = SDLEngine::threadAllocations();
+        regenerate(terrain);
+        auto allocations = SDLEngine::threadAllocations() - before;
+        auto ok          = before > first && allocations == 0;
+        std::printf("%-12s first build %zu, rebuild %zu allocations  %s\n",
+                    name, before - first, allocations, ok ? "ok" : "FAILED");
+        return ok;
+    }
+}
+
+int main() {
+    auto ok = check("full grid", 0.f);
+    ok      = check("simplified", 1.f) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,126 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "View/TerrainKernels.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // the original column at a time erosion filter, over any sample type
+    template <typename Sample>
+    void legacyFilterPass(Sample *dataP, int increment, float weight,
+                          int size) {
+        using Traits = TerrainKernels::SampleTraits<Sample>;
+        float yprev  = Traits::load(*dataP);
+        int j        = increment;
+        for (int i = 1; i < size; i++) {
+            *(dataP + j) = Traits::store(weight * yprev +
+                                         (1 - weight) * Traits::load(*(dataP + j)));
+            yprev = Traits::load(*(dataP + j));
+            j += increment;
+        }
+    }
+
+    template <typename Sample>
+    void legacyAddFilter(Sample *heights, float weight, int size) {
+        for (int i = 0; i < size; i++)
+            legacyFilterPass(&heights[size * i], 1, weight, size);
+        for (int i = 0; i < size; i++)
+            legacyFilterPass(&heights[size * i + size - 1], -1, weight, size);
+        for (int i = 0; i < size; i++)
+            legacyFilterPass(&heights[i], size, weight, size);
+        for (int i = 0; i < size; i++)
+            legacyFilterPass(&heights[size * (size - 1) + i], -size, weight,
+                             size);
+    }
+
+    // the original fault, testing the cross product at every point
+    template <typename Sample>
+    void legacyApplyFault(Sample *heights, int size, int x1, int z1, int x2,
+                          int z2, float displacement) {
+        using Traits = TerrainKernels::SampleTraits<Sample>;
+        for (int z = 0; z < size; z++) {
+            for (int x = 0; x < size; x++) {
+                if (((x - x1) * (z2 - z1) - (x2 - x1) * (z - z1)) > 0) {
+                    heights[(z * size) + x] = Traits::store(
+                        Traits::load(heights[(z * size) + x]) + displacement);
+                }
+            }
+        }
+    }
+
+    template <typename Sample>
+    std::vector<Sample> randomHeights(int size) {
+        auto engine = std::mt19937{42};
+        auto dist   = std::uniform_real_distribution<float>{0.f, 255.f};
+        auto data   = std::vector<Sample>(static_cast<size_t>(size) * size);
+        for (auto &sample : data) {
+            sample = TerrainKernels::SampleTraits<Sample>::store(dist(engine));
+        }
+        return data;
+    }
+
+    template <typename Fn>
+    double timeMs(int repeats, Fn &&fn) {
+        auto start = Clock::now();
+        for (int i = 0; i < repeats; i++) {
+            fn();
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(Clock::now() -
+                                                                 start);
+        return elapsed.count() / repeats;
+    }
+
+    template <typename Sample>
+    bool benchSize(const char *typeName, int size) {
+        constexpr auto weight = 0.1f;
+        auto repeats          = size >= 2048 ? 3 : 20;
+        auto source           = randomHeights<Sample>(size);
+
+        auto legacy   = source;
+        auto kernel   = source;
+        auto legacyMs = timeMs(repeats, [&] {
+            legacyAddFilter(legacy.data(), weight, size);
+        });
+        auto kernelMs = timeMs(repeats, [&] {
+            TerrainKernels::addFilter(kernel.data(), weight, size);
+        });
+        auto matches  = legacy == kernel;
+
+        auto faultLegacyMs = timeMs(repeats, [&] {
+            legacyApplyFault(legacy.data(), size, 3, 7, size - 5, size / 2, 1.f);
+        });
+        auto faultKernelMs = timeMs(repeats, [&] {
+            TerrainKernels::applyFault(kernel.data(), size, 3, 7, size - 5,
+                                       size / 2, 1.f);
+        });
+        matches = matches && legacy == kernel;
+
+        std::printf("%-8s %5d  addFilter legacy %8.3f ms  kernel %8.3f ms "
+                    "(%.2fx)  applyFault legacy %7.3f ms  kernel %7.3f ms "
+                    "(%.2fx)  %s\n",
+                    typeName, size, legacyMs, kernelMs, legacyMs / kernelMs,
+                    faultLegacyMs, faultKernelMs, faultLegacyMs / faultKernelMs,
+                    matches ? "ok" : "MISMATCH");
+        return matches;
+    }
+
+    template <typename Sample>
+    bool benchType(const char *typeName) {
+        auto ok = true;
+        for (auto size : {128, 256, 512, 1024, 2048, 4096}) {
+            ok = benchSize<Sample>(typeName, size) && ok;
+        }
+        return ok;
+    }
+}
+
+int main() {
+    auto ok = benchType<float>("float");
+    ok      = benchType<uint16_t>("uint16") && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -7,6 +7,7 @@
 
 #include <SDL2/SDL.h>
 
+#include "Engine/MemoryTracker.hpp"
 #include "View/GLDisplay.hpp"
 #include "View/Camera.h"
 
@@ -46,6 +47,7 @@ auto Engine::run() -> void {
         display.display();
         // run display and update methods here
     }
+    display.shutdown();
 }
 
 /**
@@ -146,9 +148,15 @@ auto Engine::getIsRunning() const -> bool {
 auto Engine::handleKeyPress(SDL_Event &event) -> void {
     switch (event.key.keysym.scancode) {
         case SDL_SCANCODE_ESCAPE: {
+            GLDisplay::get().shutdown();
             SDL_Quit();
             exit(0);
         } break;
+        case SDL_SCANCODE_M: {
+            // per subsystem memory use, printed and kept for later
+            std::cout << MemoryTracker::toJson();
+            MemoryTracker::saveJson("memory.json");
+        } break;
         default: break;
     }
 }
@@ -0,0 +1,28 @@
+#include "Engine/HeapCounter.hpp"
+
+namespace {
+    // a plain thread local, so counting costs an increment and no atomics
+    thread_local size_t allocations = 0;
+}
+
+/**
+ * @brief Returns the heap allocations made by and on behalf of this thread
+ */
+auto SDLEngine::threadAllocations() -> size_t {
+    return allocations;
+}
+
+/**
+ * @brief Credits allocations made by a worker to the thread it worked for
+ * @param count The number of allocations
+ */
+auto SDLEngine::creditThreadAllocations(size_t count) -> void {
+    allocations += count;
+}
+
+/**
+ * @brief Counts one allocation against this thread
+ */
+auto SDLEngine::countThreadAllocation() -> void {
+    ++allocations;
+}
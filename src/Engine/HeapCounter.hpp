@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+namespace SDLEngine {
+    /**
+     * @brief Returns the number of global operator new calls the calling
+     * thread has made, including those made by parallelFor ranges it handed
+     * to the worker pool. Other threads' allocations are not included, so
+     * the difference across a call is what that call allocated. Only the
+     * checks link a counting operator new, the game always reads zero.
+     */
+    auto threadAllocations() -> size_t;
+
+    /**
+     * @brief Adds allocations made on another thread on behalf of the
+     * calling thread to its count
+     */
+    auto creditThreadAllocations(size_t count) -> void;
+
+    /**
+     * @brief Counts one allocation made by the calling thread, called from
+     * a replacement operator new
+     */
+    auto countThreadAllocation() -> void;
+}
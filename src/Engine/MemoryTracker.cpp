@@ -0,0 +1,141 @@
+#include "Engine/MemoryTracker.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using SDLEngine::MemoryTag;
+using SDLEngine::MemoryTracker;
+
+namespace {
+    constexpr auto TAGS = static_cast<size_t>(MemoryTag::Count);
+
+    // one cache line each so threads recording different tags never share
+    struct alignas(64) Counters {
+        std::atomic<size_t> liveBytes{0};
+        std::atomic<size_t> peakBytes{0};
+        std::atomic<size_t> allocations{0};
+        std::atomic<size_t> frees{0};
+    };
+
+    // totals are summed from these when read, so recording only ever
+    // touches the tag's own line
+    Counters counters[TAGS];
+
+    auto grow(Counters &slot, size_t bytes) -> void {
+        auto live = slot.liveBytes.fetch_add(bytes, std::memory_order_relaxed) +
+                    bytes;
+        auto peak = slot.peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !slot.peakBytes.compare_exchange_weak(
+                                  peak, live, std::memory_order_relaxed)) {
+        }
+    }
+
+    auto read(const Counters &slot) -> MemoryTracker::Stats {
+        auto stats        = MemoryTracker::Stats{};
+        stats.liveBytes   = slot.liveBytes.load(std::memory_order_relaxed);
+        stats.peakBytes   = slot.peakBytes.load(std::memory_order_relaxed);
+        stats.allocations = slot.allocations.load(std::memory_order_relaxed);
+        stats.liveAllocations =
+            stats.allocations - slot.frees.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    auto writeStats(std::ostream &out, const MemoryTracker::Stats &stats)
+        -> void {
+        out << "{\"liveBytes\": " << stats.liveBytes
+            << ", \"peakBytes\": " << stats.peakBytes
+            << ", \"liveAllocations\": " << stats.liveAllocations
+            << ", \"allocations\": " << stats.allocations << "}";
+    }
+}
+
+/**
+ * @brief Records an allocation of bytes against tag
+ */
+auto MemoryTracker::allocated(MemoryTag tag, size_t bytes) -> void {
+    auto &slot = counters[static_cast<size_t>(tag)];
+    slot.allocations.fetch_add(1, std::memory_order_relaxed);
+    grow(slot, bytes);
+}
+
+/**
+ * @brief Records that an allocation of bytes made against tag was freed
+ */
+auto MemoryTracker::freed(MemoryTag tag, size_t bytes) -> void {
+    auto &slot = counters[static_cast<size_t>(tag)];
+    slot.frees.fetch_add(1, std::memory_order_relaxed);
+    slot.liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the counters for one tag
+ */
+auto MemoryTracker::stats(MemoryTag tag) -> Stats {
+    return read(counters[static_cast<size_t>(tag)]);
+}
+
+/**
+ * @brief Returns the counters summed over every tag. Tags peak at different
+ * times, so the peak is the sum of each tag's peak, an upper bound on the
+ * highest combined live size rather than that size itself.
+ */
+auto MemoryTracker::total() -> Stats {
+    auto stats = Stats{};
+    for (size_t i = 0; i < TAGS; i++) {
+        auto tag = read(counters[i]);
+        stats.liveBytes += tag.liveBytes;
+        stats.peakBytes += tag.peakBytes;
+        stats.liveAllocations += tag.liveAllocations;
+        stats.allocations += tag.allocations;
+    }
+    return stats;
+}
+
+/**
+ * @brief Returns the name a tag is reported under
+ */
+auto MemoryTracker::name(MemoryTag tag) -> const char * {
+    switch (tag) {
+        case MemoryTag::Heightfield: return "Heightfield";
+        case MemoryTag::Mesh: return "Mesh";
+        case MemoryTag::GpuBuffers: return "GpuBuffers";
+        case MemoryTag::Textures: return "Textures";
+        case MemoryTag::GeneratorScratch: return "GeneratorScratch";
+        default: return "Unknown";
+    }
+}
+
+/**
+ * @brief Returns every tag's counters and the totals as a JSON object
+ */
+auto MemoryTracker::toJson() -> std::string {
+    auto out = std::ostringstream{};
+    out << "{\n  \"subsystems\": {\n";
+    for (size_t i = 0; i < TAGS; i++) {
+        auto tag = static_cast<MemoryTag>(i);
+        out << "    \"" << name(tag) << "\": ";
+        writeStats(out, stats(tag));
+        out << (i + 1 < TAGS ? ",\n" : "\n");
+    }
+    out << "  },\n  \"total\": ";
+    writeStats(out, total());
+    out << "\n}\n";
+    return out.str();
+}
+
+/**
+ * @brief Writes toJson() to a file
+ * @param filename The file to write
+ * @return True if the file was written
+ */
+auto MemoryTracker::saveJson(const std::string &filename) -> bool {
+    auto outfile = std::ofstream{filename};
+    if (!outfile) {
+        std::cerr << "Cannot open file :" << filename << std::endl;
+        return false;
+    }
+    outfile << toJson();
+    return static_cast<bool>(outfile);
+}
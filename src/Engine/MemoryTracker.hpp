@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SDLEngine {
+    /**
+     * @brief Subsystems memory is accounted against
+     */
+    enum class MemoryTag {
+        Heightfield,
+        Mesh,
+        GpuBuffers,
+        Textures,
+        GeneratorScratch,
+        Count
+    };
+
+    /**
+     * @brief Process wide live and peak byte counts per subsystem. Counters
+     * are relaxed atomics on their own cache lines, so recording costs a few
+     * uncontended atomic adds and is left on in release builds.
+     */
+    class MemoryTracker {
+      public:
+        struct Stats {
+            size_t liveBytes       = 0;
+            size_t peakBytes       = 0;
+            size_t liveAllocations = 0;
+            size_t allocations     = 0;
+        };
+
+        static auto allocated(MemoryTag tag, size_t bytes) -> void;
+        static auto freed(MemoryTag tag, size_t bytes) -> void;
+
+        static auto stats(MemoryTag tag) -> Stats;
+        static auto total() -> Stats;
+        static auto name(MemoryTag tag) -> const char *;
+
+        static auto toJson() -> std::string;
+        static auto saveJson(const std::string &filename) -> bool;
+    };
+
+    /**
+     * @brief Standard allocator that accounts everything it hands out to tag
+     */
+    template <typename T, MemoryTag Tag>
+    class TrackingAllocator {
+      public:
+        using value_type = T;
+
+        template <typename U>
+        struct rebind {
+            using other = TrackingAllocator<U, Tag>;
+        };
+
+        TrackingAllocator() = default;
+
+        template <typename U>
+        TrackingAllocator(const TrackingAllocator<U, Tag> &) {}
+
+        auto allocate(size_t count) -> T * {
+            auto data = std::allocator<T>{}.allocate(count);
+            MemoryTracker::allocated(Tag, count * sizeof(T));
+            return data;
+        }
+
+        auto deallocate(T *data, size_t count) -> void {
+            MemoryTracker::freed(Tag, count * sizeof(T));
+            std::allocator<T>{}.deallocate(data, count);
+        }
+
+        template <typename U>
+        auto operator==(const TrackingAllocator<U, Tag> &) const -> bool {
+            return true;
+        }
+
+        template <typename U>
+        auto operator!=(const TrackingAllocator<U, Tag> &) const -> bool {
+            return false;
+        }
+    };
+
+    template <typename T, MemoryTag Tag>
+    using TrackedVector = std::vector<T, TrackingAllocator<T, Tag>>;
+}
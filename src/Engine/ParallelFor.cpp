@@ -0,0 +1,142 @@
+#include "Engine/ParallelFor.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "Engine/HeapCounter.hpp"
+
+namespace {
+    struct Job {
+        void (*task)(void *, size_t);
+        void *context;
+        size_t ranges;
+        std::atomic<size_t> next{0};
+        // made by the workers, credited to the caller once the job is done
+        std::atomic<size_t> allocations{0};
+    };
+
+    // set while a thread is running ranges, so a nested call runs inline
+    // instead of waiting on the pool it is part of
+    thread_local bool insideJob = false;
+
+    auto drain(Job &job) -> void {
+        for (auto range = job.next++; range < job.ranges; range = job.next++) {
+            job.task(job.context, range);
+        }
+    }
+
+    /**
+     * @brief Threads started on first use that sleep between jobs, so a
+     * parallelFor costs a wake up rather than a thread create and join
+     */
+    class WorkerPool {
+      public:
+        WorkerPool() {
+            for (unsigned i = 1; i < SDLEngine::workerCount(); i++) {
+                threads.emplace_back(&WorkerPool::work, this);
+            }
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto &thread : threads) {
+                thread.join();
+            }
+        }
+
+        auto run(Job &job) -> void {
+            // one job at a time, other callers queue here
+            std::lock_guard<std::mutex> submitted(submit);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current = &job;
+                ++generation;
+            }
+            wake.notify_all();
+
+            insideJob = true;
+            drain(job);
+            insideJob = false;
+
+            // every range has been claimed, wait for the ones still running
+            // and make sure no late waker picks the job up once it is gone
+            std::unique_lock<std::mutex> lock(mutex);
+            current = nullptr;
+            finished.wait(lock, [this] { return active == 0; });
+            SDLEngine::creditThreadAllocations(job.allocations.load());
+        }
+
+        auto empty() const -> bool {
+            return threads.empty();
+        }
+
+      private:
+        auto work() -> void {
+            insideJob = true;
+            auto seen = uint64_t{0};
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                wake.wait(lock, [&] {
+                    return stopping ||
+                           (current != nullptr && generation != seen);
+                });
+                if (stopping) {
+                    return;
+                }
+                seen     = generation;
+                auto job = current;
+                ++active;
+                lock.unlock();
+                auto before = SDLEngine::threadAllocations();
+                drain(*job);
+                job->allocations += SDLEngine::threadAllocations() - before;
+                lock.lock();
+                if (--active == 0) {
+                    finished.notify_one();
+                }
+            }
+        }
+
+        std::mutex submit;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        Job *current        = nullptr;
+        uint64_t generation = 0;
+        size_t active       = 0;
+        bool stopping       = false;
+        std::vector<std::thread> threads;
+    };
+
+    auto pool() -> WorkerPool & {
+        static WorkerPool instance;
+        return instance;
+    }
+}
+
+/**
+ * @brief Runs task(context, range) for every range in [0, ranges) on the
+ * shared worker pool, returning once all of them are done
+ * @param ranges The number of ranges
+ * @param task Called once per range, from any thread
+ * @param context Passed through to task
+ */
+auto SDLEngine::runRanges(size_t ranges, void (*task)(void *, size_t),
+                          void *context) -> void {
+    Job job;
+    job.task    = task;
+    job.context = context;
+    job.ranges  = ranges;
+    if (insideJob || pool().empty()) {
+        drain(job);
+        return;
+    }
+    pool().run(job);
+}
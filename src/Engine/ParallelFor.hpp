@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+
+namespace SDLEngine {
+    /**
+     * @brief Returns the number of threads parallelFor runs on
+     */
+    inline auto workerCount() -> unsigned {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /**
+     * @brief Runs task(context, range) for every range in [0, ranges) on the
+     * shared worker pool, see parallelFor
+     */
+    auto runRanges(size_t ranges, void (*task)(void *, size_t), void *context)
+        -> void;
+
+    /**
+     * @brief Runs fn(begin, end) over [0, count) in ranges of at most grain
+     * items, handing ranges out to a pool of worker threads that is started
+     * once and kept for the life of the program. The calling thread takes
+     * part and the call returns once every range is done. A single range, or
+     * a call made from inside another parallelFor, runs on the calling thread.
+     */
+    template <typename Fn>
+    auto parallelFor(size_t count, size_t grain, Fn &&fn) -> void {
+        grain       = std::max<size_t>(grain, 1);
+        auto ranges = (count + grain - 1) / grain;
+        if (ranges <= 1) {
+            if (count > 0) {
+                fn(size_t{0}, count);
+            }
+            return;
+        }
+
+        struct Context {
+            Fn &fn;
+            size_t count;
+            size_t grain;
+        } context{fn, count, grain};
+
+        runRanges(
+            ranges,
+            [](void *data, size_t range) {
+                auto &c    = *static_cast<Context *>(data);
+                auto begin = range * c.grain;
+                c.fn(begin, std::min(begin + c.grain, c.count));
+            },
+            &context);
+    }
+}
@@ -0,0 +1,96 @@
+#include "Engine/ScratchArena.hpp"
+
+#include <algorithm>
+#include <new>
+
+#include "Engine/MemoryTracker.hpp"
+
+using SDLEngine::MemoryTag;
+using SDLEngine::MemoryTracker;
+using SDLEngine::ScratchArena;
+
+/**
+ * @brief Creates an empty arena, blocks are allocated on first use
+ * @param blockSize The minimum size of each block in bytes
+ */
+ScratchArena::ScratchArena(size_t blockSize) : blockSize(blockSize) {}
+
+/**
+ * @brief Makes all blocks available again without freeing them, invalidating
+ * every pointer handed out since the last reset
+ */
+auto ScratchArena::reset() -> void {
+    for (auto &block : blocks) {
+        block.used = 0;
+    }
+    current = 0;
+}
+
+/**
+ * @brief Frees every block
+ */
+auto ScratchArena::release() -> void {
+    blocks.clear();
+    current = 0;
+}
+
+/**
+ * @brief Returns the number of heap allocations the arena has made
+ */
+auto ScratchArena::allocationCount() const -> size_t {
+    return heapAllocations;
+}
+
+/**
+ * @brief Returns the total size of all blocks in bytes
+ */
+auto ScratchArena::capacity() const -> size_t {
+    auto total = size_t{0};
+    for (const auto &block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
+
+/**
+ * @brief Returns the number of bytes handed out since the last reset
+ */
+auto ScratchArena::used() const -> size_t {
+    auto total = size_t{0};
+    for (const auto &block : blocks) {
+        total += block.used;
+    }
+    return total;
+}
+
+auto ScratchArena::allocateBytes(size_t bytes) -> void * {
+    bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    // walk forward through the retained blocks looking for room
+    for (; current < blocks.size(); ++current) {
+        auto &block = blocks[current];
+        if (block.size - block.used >= bytes) {
+            auto pointer = block.data.get() + block.used;
+            block.used += bytes;
+            return pointer;
+        }
+    }
+
+    auto block = Block{};
+    block.size = std::max(blockSize, bytes);
+    block.data = {static_cast<std::byte *>(::operator new[](
+                      block.size, std::align_val_t{ALIGNMENT})),
+                  AlignedDelete{block.size}};
+    MemoryTracker::allocated(MemoryTag::GeneratorScratch, block.size);
+    block.used = bytes;
+    ++heapAllocations;
+
+    blocks.push_back(std::move(block));
+    current = blocks.size() - 1;
+    return blocks.back().data.get();
+}
+
+auto ScratchArena::AlignedDelete::operator()(std::byte *data) const -> void {
+    MemoryTracker::freed(MemoryTag::GeneratorScratch, size);
+    ::operator delete[](data, std::align_val_t{ALIGNMENT});
+}
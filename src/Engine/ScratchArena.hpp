@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace SDLEngine {
+    /**
+     * @brief Bump allocator for per-run scratch memory. Blocks are kept when
+     * the arena is reset, so a pipeline that makes the same requests every
+     * run stops touching the heap after the first one. Blocks are accounted
+     * to MemoryTag::GeneratorScratch.
+     */
+    class ScratchArena {
+      public:
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+        static constexpr size_t ALIGNMENT          = 64;
+
+        explicit ScratchArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+        ScratchArena(ScratchArena &&)      = default;
+        ScratchArena(const ScratchArena &) = delete;
+
+        auto operator=(ScratchArena &&) -> ScratchArena & = default;
+        auto operator=(const ScratchArena &) -> ScratchArena & = delete;
+
+        /**
+         * @brief Returns uninitialised, cache line aligned storage for count
+         * objects, valid until the next reset
+         */
+        template <typename T>
+        auto allocate(size_t count) -> T * {
+            static_assert(std::is_trivially_destructible_v<T>,
+                          "arena memory is never destroyed");
+            return static_cast<T *>(allocateBytes(count * sizeof(T)));
+        }
+
+        auto reset() -> void;
+        auto release() -> void;
+
+        auto allocationCount() const -> size_t;
+        auto capacity() const -> size_t;
+        auto used() const -> size_t;
+
+      private:
+        struct AlignedDelete {
+            // in bytes, reported to the memory tracker when freed
+            size_t size;
+
+            auto operator()(std::byte *data) const -> void;
+        };
+
+        struct Block {
+            std::unique_ptr<std::byte[], AlignedDelete> data;
+            size_t size = 0;
+            size_t used = 0;
+        };
+
+        auto allocateBytes(size_t bytes) -> void *;
+
+        size_t blockSize;
+        size_t current         = 0;
+        size_t heapAllocations = 0;
+        std::vector<Block> blocks;
+    };
+}
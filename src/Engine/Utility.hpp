@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+/* SSE2 is part of x86-64 and an opt-in on 32 bit x86. */
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define SDLENGINE_SSE2 1
+#endif
+
+namespace SDLEngine {
+    /**
+     * @brief The 64 bit FNV-1a offset basis, the hash of no data
+     */
+    constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+    /**
+     * @brief Folds one value into a 64 bit FNV-1a hash
+     * @param hash The hash so far, FNV_OFFSET_BASIS to start
+     * @param value A byte, or a wider word for a faster, weaker mix
+     */
+    constexpr auto fnv1a(uint64_t hash, uint64_t value) -> uint64_t {
+        return (hash ^ value) * 1099511628211ull;
+    }
+
+    /**
+     * @brief Converts a value in 0 to 1 to a rounded byte, clamping values
+     * outside that range
+     */
+    inline auto toByte(float value) -> uint8_t {
+        return static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+    }
+}
@@ -26,8 +26,28 @@ GLDisplay::GLDisplay() {
     // gluLookAt(256, 256, 0, 256, 0, 256, 0, 1, 0);
     gluLookAt(0, 256, 0, 256, 0, 256, 0, 1, 0);
 
+    // testTerrain.terrainData.setStorage(Heightfield::Storage::Quantized16);
     // testTerrain.flatTerrain(128);
-    testTerrain.genFaultFormation(256, 512, 0, 255, 0.1, 20, 0);
+    // testTerrain.genFaultFormation(256, 512, 0, 255, 0.1, 20, 0);
+    testTerrain.setMaxMeshError(1.f);
+    testTerrain.setBakedLighting(true);
+    testTerrain.setSplatting(true);
+    Scatter::Parameters trees;
+    trees.minHeight = 0.2f;
+    trees.maxHeight = 0.7f;
+    trees.maxSlope  = 0.6f;
+    trees.density   = 0.6f;
+    testTerrain.addScatter(trees);
+    Scatter::Parameters rocks;
+    rocks.shape    = Scatter::Shape::Rock;
+    rocks.radius   = 10.f;
+    rocks.minSlope = 0.3f;
+    rocks.maxSlope = 4.f;
+    rocks.minScale = 1.5f;
+    rocks.maxScale = 5.f;
+    rocks.seed     = 2;
+    testTerrain.addScatter(rocks);
+    testTerrain.genFaultFormationProgressive(256, 512, 0, 255, 0.1, 20, 0);
     // testTerrain.genFaultFormation(16, 128, 100, 200, 1, 1);
     // testTerrain.loadHeightfield("height128.raw", 128);
     glEnable(GL_LIGHTING);
@@ -47,6 +67,8 @@ auto GLDisplay::display() -> void {
         testTerrain.createTriangles();
         firstRun = 0;
     }
+    // swap in the next progressive level once it has been generated
+    testTerrain.updateProgressive();
 
     auto &engine = SDLEngine::Engine::get();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -70,6 +92,12 @@ auto GLDisplay::update(double dt) -> void {
     // dt == delta time
 }
 
+auto GLDisplay::shutdown() -> void {
+    // GL objects have to go while the context exists, the static instance
+    // is only destroyed after SDL has torn it down
+    testTerrain.shutdown();
+}
+
 auto GLDisplay::get() -> GLDisplay & {
     static auto instance = GLDisplay{};
 
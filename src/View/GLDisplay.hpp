@@ -25,6 +25,7 @@ namespace View {
         static auto get() -> GLDisplay &;
         auto display() -> void;
         auto update(double dt) -> void;
+        auto shutdown() -> void;
         auto drawRectangle(float width, float height) -> void;
         char heightmap[heightMapSize][heightMapSize];
         Terrain testTerrain;
@@ -0,0 +1,324 @@
+#include "Heightfield.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+
+#include "Engine/Utility.hpp"
+
+namespace {
+    constexpr int TILE_SAMPLES =
+        Heightfield::TILE_SIZE * Heightfield::TILE_SIZE;
+    constexpr float QUANTIZED_RANGE = 65535.f;
+    constexpr uint64_t QUANTIZED_MAX = 65535;
+    // widening past this many doublings would overflow the code remap, and
+    // no 16-bit code has any precision left by then anyway
+    constexpr int MAX_WIDEN_SHIFT = 47;
+}
+
+Heightfield::Heightfield(int size, float fill) {
+    resize(size, fill);
+}
+
+void Heightfield::resize(int size, float fill) {
+    tiles.clear();
+    gridSize    = std::max(size, 0);
+    tilesPerRow = (gridSize + TILE_SIZE - 1) >> TILE_SHIFT;
+
+    auto count = static_cast<size_t>(tilesPerRow) * tilesPerRow;
+    tiles.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        auto tile = std::make_shared<Tile>();
+        if (mode == Storage::Quantized16) {
+            tile->quantized.assign(TILE_SAMPLES, 0);
+            tile->offset = fill;
+        } else {
+            tile->samples.assign(TILE_SAMPLES, fill);
+        }
+        tiles.push_back(std::move(tile));
+    }
+}
+
+void Heightfield::assign(const float *heights, int size) {
+    if (size != gridSize) {
+        resize(size);
+    }
+    // gather each tile from the row major size * size array, repeating the
+    // last row and column into the padding of partial edge tiles
+    std::array<float, TILE_SAMPLES> values;
+    for (int tileZ = 0; tileZ < tilesPerRow; tileZ++) {
+        for (int tileX = 0; tileX < tilesPerRow; tileX++) {
+            auto x0    = tileX << TILE_SHIFT;
+            auto count = std::min(TILE_SIZE, gridSize - x0);
+            for (int row = 0; row < TILE_SIZE; row++) {
+                auto z     = std::min((tileZ << TILE_SHIFT) + row, gridSize - 1);
+                auto first = heights + static_cast<size_t>(z) * gridSize + x0;
+                auto last  = std::copy(first, first + count,
+                                      values.begin() + (row << TILE_SHIFT));
+                std::fill(last, values.begin() + ((row + 1) << TILE_SHIFT),
+                          first[count - 1]);
+            }
+
+            // every sample of the tile is overwritten, so a tile still shared
+            // with a snapshot is replaced rather than cloned, and an unshared
+            // one is reused in place
+            auto &slot = tiles[static_cast<size_t>(tileZ) * tilesPerRow + tileX];
+            if (slot.use_count() > 1) {
+                slot = std::make_shared<Tile>();
+            }
+            auto &tile = *slot;
+            if (mode == Storage::Quantized16) {
+                tile.quantize(values.data());
+            } else {
+                Quantized().swap(tile.quantized);
+                tile.samples.assign(values.begin(), values.end());
+            }
+        }
+    }
+}
+
+void Heightfield::clear() {
+    tiles.clear();
+    gridSize    = 0;
+    tilesPerRow = 0;
+}
+
+void Heightfield::setStorage(Storage storage) {
+    mode = storage;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        if (tiles[i]->isQuantized() != (mode == Storage::Quantized16)) {
+            convertTile(mutableTile(i));
+        }
+    }
+}
+
+Heightfield::Storage Heightfield::storage() const {
+    return mode;
+}
+
+int Heightfield::size() const {
+    return gridSize;
+}
+
+bool Heightfield::empty() const {
+    return gridSize == 0;
+}
+
+float Heightfield::get(int x, int z) const {
+    auto local = ((z & (TILE_SIZE - 1)) << TILE_SHIFT) | (x & (TILE_SIZE - 1));
+    return tiles[tileIndex(x, z)]->sample(local);
+}
+
+void Heightfield::set(int x, int z, float height) {
+    auto local = ((z & (TILE_SIZE - 1)) << TILE_SHIFT) | (x & (TILE_SIZE - 1));
+    auto index = tileIndex(x, z);
+    // writing a flat tile's own height changes nothing, so don't clone it
+    const auto &current = *tiles[index];
+    if (current.isQuantized() && current.scale == 0.f &&
+        height == current.offset) {
+        return;
+    }
+    auto &tile = mutableTile(index);
+    if (!tile.isQuantized()) {
+        tile.samples[local] = height;
+        return;
+    }
+    if (height < tile.offset ||
+        height > tile.offset + tile.scale * QUANTIZED_RANGE) {
+        tile.widen(height);
+    }
+    auto q = tile.scale > 0.f ? (height - tile.offset) / tile.scale : 0.f;
+    tile.quantized[local] =
+        static_cast<uint16_t>(std::lround(std::clamp(q, 0.f, QUANTIZED_RANGE)));
+}
+
+void Heightfield::readRow(int z, int x, int count, float *out) const {
+    auto rowZ = (z & (TILE_SIZE - 1)) << TILE_SHIFT;
+    while (count > 0) {
+        auto localX = x & (TILE_SIZE - 1);
+        auto span   = std::min(count, TILE_SIZE - localX);
+        tiles[tileIndex(x, z)]->dequantize(rowZ + localX, span, out);
+        out += span;
+        x += span;
+        count -= span;
+    }
+}
+
+size_t Heightfield::tileCount() const {
+    return tiles.size();
+}
+
+size_t Heightfield::sharedTileCount() const {
+    return static_cast<size_t>(
+        std::count_if(tiles.begin(), tiles.end(),
+                      [](const auto &tile) { return tile.use_count() > 1; }));
+}
+
+size_t Heightfield::tileIndex(int x, int z) const {
+    return static_cast<size_t>(z >> TILE_SHIFT) * tilesPerRow +
+           (x >> TILE_SHIFT);
+}
+
+Heightfield::Tile &Heightfield::mutableTile(size_t index) {
+    // clone the tile if any other snapshot still references it
+    if (tiles[index].use_count() > 1) {
+        tiles[index] = std::make_shared<Tile>(*tiles[index]);
+    }
+    return *tiles[index];
+}
+
+void Heightfield::convertTile(Tile &tile) {
+    if (tile.isQuantized()) {
+        tile.toFloat();
+    } else {
+        tile.quantize(tile.samples.data());
+    }
+}
+
+bool Heightfield::Tile::isQuantized() const {
+    return !quantized.empty();
+}
+
+float Heightfield::Tile::sample(int local) const {
+    if (isQuantized()) {
+        return quantized[local] * scale + offset;
+    }
+    return samples[local];
+}
+
+void Heightfield::Tile::dequantize(int local, int count, float *out) const {
+    if (!isQuantized()) {
+        std::copy(samples.begin() + local, samples.begin() + local + count, out);
+        return;
+    }
+    auto source = quantized.data() + local;
+    int i       = 0;
+#if defined(SDLENGINE_SSE2)
+    // widen eight samples at a time to 32-bit and convert to float
+    auto vScale  = _mm_set1_ps(scale);
+    auto vOffset = _mm_set1_ps(offset);
+    auto zero    = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        auto packed =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+        auto low  = _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, zero));
+        auto high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(packed, zero));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(low, vScale), vOffset));
+        _mm_storeu_ps(out + i + 4,
+                      _mm_add_ps(_mm_mul_ps(high, vScale), vOffset));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = source[i] * scale + offset;
+    }
+}
+
+void Heightfield::Tile::quantize(const float *values) {
+    auto range = std::minmax_element(values, values + TILE_SAMPLES);
+    offset     = *range.first;
+    scale      = (*range.second - offset) / QUANTIZED_RANGE;
+
+    auto inverse = scale > 0.f ? 1.f / scale : 0.f;
+    quantized.resize(TILE_SAMPLES);
+    for (int i = 0; i < TILE_SAMPLES; i++) {
+        auto q       = std::min((values[i] - offset) * inverse, QUANTIZED_RANGE);
+        quantized[i] = static_cast<uint16_t>(q + 0.5f);
+    }
+    // values may point into samples, so only release them once quantized
+    Samples().swap(samples);
+}
+
+void Heightfield::Tile::widen(float height) {
+    // grow the range to twice the span it needs, on the side the height fell
+    // outside, so a run of edits in one direction rarely widens again. The new
+    // scale is the old one times a power of two and the new offset a whole
+    // number of old steps lower, so the codes are remapped with an integer
+    // shift instead of a round trip through floats
+    auto top    = offset + static_cast<double>(scale) * QUANTIZED_RANGE;
+    auto low    = std::min(static_cast<double>(offset), static_cast<double>(height));
+    auto high   = std::max(top, static_cast<double>(height));
+    auto needed = 2.0 * (high - low);
+
+    if (scale == 0.f) {
+        // every code is 0, which becomes the top of the range when growing
+        // downwards
+        scale = static_cast<float>(needed / QUANTIZED_RANGE);
+        if (height < offset) {
+            offset = static_cast<float>(top - static_cast<double>(scale) *
+                                                  QUANTIZED_RANGE);
+            std::fill(quantized.begin(), quantized.end(),
+                      static_cast<uint16_t>(QUANTIZED_MAX));
+        }
+        return;
+    }
+
+    auto shift = 0;
+    while (shift < MAX_WIDEN_SHIFT &&
+           std::ldexp(static_cast<double>(scale), shift) * QUANTIZED_RANGE <
+               needed) {
+        ++shift;
+    }
+    // growing downwards keeps the top of the range where it was
+    auto steps = height < offset ? ((uint64_t{1} << shift) - 1) * QUANTIZED_MAX
+                                 : uint64_t{0};
+    auto half  = shift > 0 ? uint64_t{1} << (shift - 1) : uint64_t{0};
+    for (auto &code : quantized) {
+        code = static_cast<uint16_t>(
+            std::min((code + steps + half) >> shift, QUANTIZED_MAX));
+    }
+    offset = static_cast<float>(offset - static_cast<double>(steps) * scale);
+    scale  = std::ldexp(scale, shift);
+}
+
+void Heightfield::Tile::toFloat() {
+    samples.resize(TILE_SAMPLES);
+    dequantize(0, TILE_SAMPLES, samples.data());
+    Quantized().swap(quantized);
+}
+
+HeightfieldHistory::HeightfieldHistory(size_t limit) : limit(limit) {}
+
+void HeightfieldHistory::push(const Heightfield &state) {
+    if (limit == 0) {
+        return;
+    }
+    if (undoStack.size() == limit) {
+        undoStack.erase(undoStack.begin());
+    }
+    undoStack.push_back(state);
+    redoStack.clear();
+}
+
+bool HeightfieldHistory::undo(Heightfield &current) {
+    if (undoStack.empty()) {
+        return false;
+    }
+    redoStack.push_back(std::move(current));
+    current = std::move(undoStack.back());
+    undoStack.pop_back();
+    return true;
+}
+
+bool HeightfieldHistory::redo(Heightfield &current) {
+    if (redoStack.empty()) {
+        return false;
+    }
+    undoStack.push_back(std::move(current));
+    current = std::move(redoStack.back());
+    redoStack.pop_back();
+    return true;
+}
+
+bool HeightfieldHistory::canUndo() const {
+    return !undoStack.empty();
+}
+
+bool HeightfieldHistory::canRedo() const {
+    return !redoStack.empty();
+}
+
+void HeightfieldHistory::clear() {
+    undoStack.clear();
+    redoStack.clear();
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Engine/MemoryTracker.hpp"
+
+/**
+ * @brief Square heightfield stored as fixed size, reference counted tiles.
+ * Copying a Heightfield only copies the tile pointers, so snapshots are
+ * O(tiles). A tile shared with another copy is cloned the first time it is
+ * written (copy-on-write), so memory grows with the amount of terrain edited
+ * rather than with the number of snapshots held.
+ *
+ * Tiles are either 32-bit float or 16-bit quantized with a per-tile scale and
+ * offset. Quantized tiles are dequantized on read; readRow() does this in
+ * bulk with SIMD where available.
+ */
+class Heightfield {
+
+  public:
+    static constexpr int TILE_SHIFT = 6;
+    static constexpr int TILE_SIZE  = 1 << TILE_SHIFT;
+
+    enum class Storage { Float32, Quantized16 };
+
+    Heightfield() = default;
+    explicit Heightfield(int size, float fill = 0.f);
+
+    void resize(int size, float fill = 0.f);
+    void assign(const float *heights, int size);
+    void clear();
+    void setStorage(Storage mode);
+
+    Storage storage() const;
+    int size() const;
+    bool empty() const;
+    float get(int x, int z) const;
+    void set(int x, int z, float height);
+    void readRow(int z, int x, int count, float *out) const;
+
+    size_t tileCount() const;
+    size_t sharedTileCount() const;
+
+  private:
+    using Samples =
+        SDLEngine::TrackedVector<float, SDLEngine::MemoryTag::Heightfield>;
+    using Quantized =
+        SDLEngine::TrackedVector<uint16_t, SDLEngine::MemoryTag::Heightfield>;
+
+    // a tile holds either float samples or quantized samples, never both
+    struct Tile {
+        Samples samples;
+        Quantized quantized;
+        float scale  = 0.f;
+        float offset = 0.f;
+
+        bool isQuantized() const;
+        float sample(int local) const;
+        void dequantize(int local, int count, float *out) const;
+        void quantize(const float *values);
+        void widen(float height);
+        void toFloat();
+    };
+
+    size_t tileIndex(int x, int z) const;
+    Tile &mutableTile(size_t index);
+    void convertTile(Tile &tile);
+
+    Storage mode    = Storage::Float32;
+    int gridSize    = 0;
+    int tilesPerRow = 0;
+    std::vector<std::shared_ptr<Tile>> tiles;
+};
+
+/**
+ * @brief Bounded undo/redo stacks of Heightfield snapshots. Each entry shares
+ * every tile it has in common with its neighbours, so an entry only costs the
+ * tiles that were edited between the two states.
+ */
+class HeightfieldHistory {
+
+  public:
+    explicit HeightfieldHistory(size_t limit = 64);
+
+    void push(const Heightfield &state);
+    bool undo(Heightfield &current);
+    bool redo(Heightfield &current);
+    bool canUndo() const;
+    bool canRedo() const;
+    void clear();
+
+  private:
+    size_t limit;
+    std::vector<Heightfield> undoStack;
+    std::vector<Heightfield> redoStack;
+};
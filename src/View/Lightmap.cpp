@@ -0,0 +1,445 @@
+#include "Lightmap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Engine/ParallelFor.hpp"
+#include "Engine/Utility.hpp"
+
+using SDLEngine::toByte;
+
+namespace {
+    // sweep directions, counter-clockwise from +x towards +z in 45 degree
+    // steps, so direction k points along azimuth k * pi / 4
+    constexpr int DIRECTIONS       = 8;
+    constexpr int DIRECTION_X[8]   = {1, 1, 0, -1, -1, -1, 0, 1};
+    constexpr int DIRECTION_Z[8]   = {0, 1, 1, 1, 0, -1, -1, -1};
+    constexpr float PI             = 3.14159265f;
+    // angular width of the soft edge of the sun's shadow
+    constexpr float PENUMBRA       = 0.05f;
+    constexpr size_t LINES_PER_TASK = 16;
+    constexpr int ROWS_PER_TASK     = 8;
+
+    constexpr char CACHE_MAGIC[4]    = {'T', 'L', 'M', 'P'};
+    // 2 dropped the normal planes, 3 brought them back for render()
+    constexpr uint32_t CACHE_VERSION = 3;
+
+#if defined(SDLENGINE_SSE2)
+    // clamp four values to 0 to 1 and store them as bytes
+    void storeBytes(uint8_t *out, __m128 values) {
+        values = _mm_min_ps(_mm_max_ps(values, _mm_setzero_ps()),
+                            _mm_set1_ps(1.f));
+        auto scaled = _mm_cvttps_epi32(
+            _mm_add_ps(_mm_mul_ps(values, _mm_set1_ps(255.f)),
+                       _mm_set1_ps(0.5f)));
+        auto packed = _mm_packs_epi32(scaled, scaled);
+        auto bytes  = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+        std::memcpy(out, &bytes, 4);
+    }
+#endif
+}
+
+uint64_t Lightmap::key(const float *heights, int size,
+                       const Parameters &parameters) {
+    // FNV-1a over 32-bit words rather than bytes, the map is large
+    auto hash = SDLEngine::FNV_OFFSET_BASIS;
+    auto mix  = [&hash](const void *data, size_t words) {
+        auto bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < words; i++) {
+            uint32_t word;
+            std::memcpy(&word, bytes + i * 4, 4);
+            hash = SDLEngine::fnv1a(hash, word);
+        }
+    };
+    static_assert(sizeof(Parameters) % 4 == 0, "parameters are hashed by word");
+    mix(&size, 1);
+    mix(&parameters, sizeof(Parameters) / 4);
+    mix(heights, static_cast<size_t>(size) * size);
+    return hash;
+}
+
+void Lightmap::bake(const float *heights, int size,
+                    const Parameters &parameters) {
+    clear();
+    if (size < 2) {
+        return;
+    }
+    params  = parameters;
+    mapSize = size;
+    hash    = key(heights, size, parameters);
+
+    auto count = static_cast<size_t>(size) * size;
+    scratch.reset();
+    auto occlusionSum  = scratch.allocate<float>(count);
+    auto sunVisibility = scratch.allocate<float>(count);
+    std::fill(occlusionSum, occlusionSum + count, 0.f);
+
+    // a hull per line for each slot a thread can sweep in, no line is
+    // longer than the map
+    auto slots = std::min<size_t>(SDLEngine::workerCount(),
+                                  (2 * static_cast<size_t>(size) +
+                                   LINES_PER_TASK - 1) / LINES_PER_TASK);
+    auto hulls = scratch.allocate<HullPoint>(slots * LINES_PER_TASK * size);
+
+    // the horizon towards the sun is found by the sweep travelling away from
+    // it, whose hull holds the samples lying sunwards of each texel. Shadows
+    // therefore snap to the nearest of the eight sweep directions while the
+    // diffuse term in shade() uses the exact azimuth, so the two can disagree
+    // by up to 22.5 degrees
+    auto step      = 2.f * PI / DIRECTIONS;
+    auto azimuth   = std::remainder(params.sunAzimuth, 2.f * PI);
+    auto sunwards  = static_cast<int>(std::lround(azimuth / step));
+    auto sunSweep  = ((sunwards % DIRECTIONS) + DIRECTIONS + DIRECTIONS / 2) %
+                    DIRECTIONS;
+
+    for (int direction = 0; direction < DIRECTIONS; direction++) {
+        sweep(heights, direction, occlusionSum,
+              direction == sunSweep ? sunVisibility : nullptr,
+              params.sunElevation, hulls, slots);
+    }
+    shade(heights, occlusionSum, sunVisibility);
+}
+
+void Lightmap::bakeNormals(const float *heights, int size,
+                           const Parameters &parameters) {
+    clear();
+    if (size < 2) {
+        return;
+    }
+    params  = parameters;
+    mapSize = size;
+    shade(heights, nullptr, nullptr);
+}
+
+void Lightmap::sweep(const float *heights, int direction, float *occlusionSum,
+                     float *sunVisibility, float sunElevation, HullPoint *hulls,
+                     size_t slots) const {
+    auto dx   = DIRECTION_X[direction];
+    auto dz   = DIRECTION_Z[direction];
+    auto step = std::sqrt(dx * dx * params.scaleX * params.scaleX +
+                          dz * dz * params.scaleZ * params.scaleZ);
+
+    // every line starts on the edge the sweep enters the grid from, first
+    // one per row if the sweep moves along x, then one per column if it
+    // moves along z, skipping the corner a row line already starts on
+    auto x0       = dx > 0 ? 0 : mapSize - 1;
+    auto z0       = dz > 0 ? 0 : mapSize - 1;
+    auto rowLines = dx != 0 ? mapSize : 0;
+    auto columnLines = dz == 0 ? 0 : (dx != 0 ? mapSize - 1 : mapSize);
+    auto lineCount   = static_cast<size_t>(rowLines + columnLines);
+    auto columnSkip  = dx > 0 ? 1 : 0;
+    auto start       = [&](size_t line, int &x, int &z) {
+        if (line < static_cast<size_t>(rowLines)) {
+            x = x0;
+            z = static_cast<int>(line);
+        } else {
+            x = static_cast<int>(line) - rowLines + columnSkip;
+            z = z0;
+        }
+    };
+
+    // only texels near the edge of the shadow need the exact angle
+    auto litSlope    = std::tan(std::max(sunElevation - PENUMBRA * 0.5f, 0.f));
+    auto shadowSlope = std::tan(std::min(sunElevation + PENUMBRA * 0.5f, PI * 0.49f));
+
+    // the lines of a task advance together a step at a time, so neighbouring
+    // lines share cache lines even when they run down columns or diagonals.
+    // Each slot takes tasks until none are left and keeps its hulls in its
+    // own part of the preallocated storage.
+    auto tasks    = (lineCount + LINES_PER_TASK - 1) / LINES_PER_TASK;
+    auto nextTask = std::atomic<size_t>{0};
+    SDLEngine::parallelFor(slots, 1, [&](size_t slot, size_t) {
+        auto slotHulls = hulls + slot * LINES_PER_TASK * mapSize;
+        for (auto task = nextTask++; task < tasks; task = nextTask++) {
+            auto begin = task * LINES_PER_TASK;
+            auto lines = std::min(LINES_PER_TASK, lineCount - begin);
+            int startX[LINES_PER_TASK];
+            int startZ[LINES_PER_TASK];
+            size_t hullSize[LINES_PER_TASK];
+            for (size_t line = 0; line < lines; line++) {
+                start(begin + line, startX[line], startZ[line]);
+                hullSize[line] = 0;
+            }
+
+            auto active = lines;
+            for (int i = 0; active > 0; i++) {
+                active = 0;
+                for (size_t line = 0; line < lines; line++) {
+                    auto x = startX[line] + i * dx;
+                    auto z = startZ[line] + i * dz;
+                    if (x < 0 || x >= mapSize || z < 0 || z >= mapSize) {
+                        continue;
+                    }
+                    active++;
+
+                    auto hull  = slotHulls + line * mapSize;
+                    auto &used = hullSize[line];
+                    auto index = static_cast<size_t>(z) * mapSize + x;
+                    auto point = HullPoint{i * step, heights[index] * params.scaleY};
+
+                    // drop hull points hidden behind the one before them as
+                    // seen from here, they can't be anyone's horizon again
+                    while (used >= 2) {
+                        auto &a = hull[used - 1];
+                        auto &b = hull[used - 2];
+                        if ((b.height - point.height) *
+                                (point.distance - a.distance) <
+                            (a.height - point.height) *
+                                (point.distance - b.distance)) {
+                            break;
+                        }
+                        used--;
+                    }
+
+                    auto slope = 0.f;
+                    if (used > 0) {
+                        slope = std::max(0.f, (hull[used - 1].height - point.height) /
+                                                  (point.distance -
+                                                   hull[used - 1].distance));
+                    }
+                    hull[used++] = point;
+
+                    // sine of the horizon elevation
+                    occlusionSum[index] += slope / std::sqrt(1.f + slope * slope);
+                    if (sunVisibility == nullptr) {
+                        continue;
+                    }
+                    if (slope <= litSlope) {
+                        sunVisibility[index] = 1.f;
+                    } else if (slope >= shadowSlope) {
+                        sunVisibility[index] = 0.f;
+                    } else {
+                        auto clearance = sunElevation - std::atan(slope);
+                        sunVisibility[index] =
+                            std::clamp(0.5f + clearance / PENUMBRA, 0.f, 1.f);
+                    }
+                }
+            }
+        }
+    });
+}
+
+void Lightmap::shade(const float *heights, const float *occlusionSum,
+                     const float *sunVisibility) {
+    // without the sweeps' sums only the normal map is written
+    auto lit   = occlusionSum != nullptr;
+    auto count = static_cast<size_t>(mapSize) * mapSize;
+    normalX.resize(count);
+    normalY.resize(count);
+    normalZ.resize(count);
+    if (lit) {
+        occlusionMap.resize(count);
+        shadowMap.resize(count);
+        lightMap.resize(count);
+    }
+
+    auto sunX = std::cos(params.sunElevation) * std::cos(params.sunAzimuth);
+    auto sunY = std::sin(params.sunElevation);
+    auto sunZ = std::cos(params.sunElevation) * std::sin(params.sunAzimuth);
+    auto occlusionScale = 1.f / DIRECTIONS;
+
+    // central differences, one-sided along the edges of the map
+    auto shadeTexel = [&](int x, int z, const float *left, const float *right,
+                          float spanX, const float *up, const float *down,
+                          float spanZ) {
+        auto index = static_cast<size_t>(z) * mapSize + x;
+        auto gx    = (right[x] - left[x]) * params.scaleY / spanX;
+        auto gz    = (down[x] - up[x]) * params.scaleY / spanZ;
+        auto inv   = 1.f / std::sqrt(gx * gx + 1.f + gz * gz);
+        auto nx = -gx * inv, ny = inv, nz = -gz * inv;
+        normalX[index] = toByte(nx * 0.5f + 0.5f);
+        normalY[index] = toByte(ny * 0.5f + 0.5f);
+        normalZ[index] = toByte(nz * 0.5f + 0.5f);
+        if (!lit) {
+            return;
+        }
+
+        auto ambient = 1.f - occlusionSum[index] * occlusionScale;
+        auto direct =
+            std::max(0.f, nx * sunX + ny * sunY + nz * sunZ) * sunVisibility[index];
+        occlusionMap[index] = toByte(ambient);
+        shadowMap[index]    = toByte(sunVisibility[index]);
+        lightMap[index] = toByte(params.ambient * ambient + params.diffuse * direct);
+    };
+
+    SDLEngine::parallelFor(mapSize, ROWS_PER_TASK, [&](size_t begin, size_t end) {
+        for (auto z = static_cast<int>(begin); z < static_cast<int>(end); z++) {
+            auto zUp   = std::max(z - 1, 0);
+            auto zDown = std::min(z + 1, mapSize - 1);
+            auto base  = static_cast<size_t>(z) * mapSize;
+            auto row   = heights + base;
+            auto up    = heights + static_cast<size_t>(zUp) * mapSize;
+            auto down  = heights + static_cast<size_t>(zDown) * mapSize;
+            auto spanZ = (zDown - zUp) * params.scaleZ;
+            auto spanX = 2.f * params.scaleX;
+
+            shadeTexel(0, z, row, row + 1, params.scaleX, up, down, spanZ);
+            int x = 1;
+#if defined(SDLENGINE_SSE2)
+            auto vScaleX   = _mm_set1_ps(params.scaleY / spanX);
+            auto vScaleZ   = _mm_set1_ps(params.scaleY / spanZ);
+            auto vSunX     = _mm_set1_ps(sunX);
+            auto vSunY     = _mm_set1_ps(sunY);
+            auto vSunZ     = _mm_set1_ps(sunZ);
+            auto vAmbient  = _mm_set1_ps(params.ambient);
+            auto vDiffuse  = _mm_set1_ps(params.diffuse);
+            auto vOcclude  = _mm_set1_ps(occlusionScale);
+            auto one       = _mm_set1_ps(1.f);
+            auto half      = _mm_set1_ps(0.5f);
+            auto zero      = _mm_setzero_ps();
+            for (; x + 4 <= mapSize - 1; x += 4) {
+                auto index = base + x;
+                auto gx    = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x + 1),
+                                                   _mm_loadu_ps(row + x - 1)),
+                                        vScaleX);
+                auto gz    = _mm_mul_ps(
+                    _mm_sub_ps(_mm_loadu_ps(down + x), _mm_loadu_ps(up + x)),
+                    vScaleZ);
+                auto length = _mm_sqrt_ps(_mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(gx, gx), one), _mm_mul_ps(gz, gz)));
+                auto ny = _mm_div_ps(one, length);
+                auto nx = _mm_sub_ps(zero, _mm_mul_ps(gx, ny));
+                auto nz = _mm_sub_ps(zero, _mm_mul_ps(gz, ny));
+                storeBytes(&normalX[index], _mm_add_ps(_mm_mul_ps(nx, half), half));
+                storeBytes(&normalY[index], _mm_add_ps(_mm_mul_ps(ny, half), half));
+                storeBytes(&normalZ[index], _mm_add_ps(_mm_mul_ps(nz, half), half));
+                if (!lit) {
+                    continue;
+                }
+
+                auto ambient = _mm_sub_ps(
+                    one, _mm_mul_ps(_mm_loadu_ps(occlusionSum + index), vOcclude));
+                auto visible = _mm_loadu_ps(sunVisibility + index);
+                auto facing  = _mm_max_ps(
+                    zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, vSunX),
+                                                _mm_mul_ps(ny, vSunY)),
+                                     _mm_mul_ps(nz, vSunZ)));
+                auto light = _mm_add_ps(
+                    _mm_mul_ps(vAmbient, ambient),
+                    _mm_mul_ps(vDiffuse, _mm_mul_ps(facing, visible)));
+
+                storeBytes(&occlusionMap[index], ambient);
+                storeBytes(&shadowMap[index], visible);
+                storeBytes(&lightMap[index], light);
+            }
+#endif
+            for (; x < mapSize - 1; x++) {
+                shadeTexel(x, z, row - 1, row + 1, spanX, up, down, spanZ);
+            }
+            shadeTexel(mapSize - 1, z, row - 1, row, params.scaleX, up, down,
+                       spanZ);
+        }
+    });
+}
+
+bool Lightmap::load(const std::string &filename, uint64_t expectedKey) {
+    std::ifstream infile(filename, std::ios::binary);
+    if (!infile) {
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    int32_t size     = 0;
+    uint64_t stored  = 0;
+    // kept aside until the whole file has been read
+    Parameters parameters;
+    infile.read(magic, sizeof(magic));
+    infile.read(reinterpret_cast<char *>(&version), sizeof(version));
+    infile.read(reinterpret_cast<char *>(&size), sizeof(size));
+    infile.read(reinterpret_cast<char *>(&stored), sizeof(stored));
+    infile.read(reinterpret_cast<char *>(&parameters), sizeof(parameters));
+    if (!infile || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+        version != CACHE_VERSION || stored != expectedKey || size < 2) {
+        clear();
+        return false;
+    }
+
+    auto count = static_cast<size_t>(size) * size;
+    for (auto plane : {&normalX, &normalY, &normalZ, &occlusionMap, &shadowMap,
+                       &lightMap}) {
+        plane->resize(count);
+        infile.read(reinterpret_cast<char *>(plane->data()), count);
+    }
+    if (!infile) {
+        std::cerr << "Truncated lightmap :" << filename << std::endl;
+        clear();
+        return false;
+    }
+    params  = parameters;
+    mapSize = size;
+    hash    = stored;
+    return true;
+}
+
+bool Lightmap::save(const std::string &filename) const {
+    std::ofstream outfile(filename, std::ios::binary);
+    if (!outfile) {
+        std::cerr << "Cannot open file :" << filename << std::endl;
+        return false;
+    }
+
+    auto size = static_cast<int32_t>(mapSize);
+    outfile.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    outfile.write(reinterpret_cast<const char *>(&CACHE_VERSION),
+                  sizeof(CACHE_VERSION));
+    outfile.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    outfile.write(reinterpret_cast<const char *>(&hash), sizeof(hash));
+    outfile.write(reinterpret_cast<const char *>(&params), sizeof(params));
+    for (auto plane : {&normalX, &normalY, &normalZ, &occlusionMap, &shadowMap,
+                       &lightMap}) {
+        outfile.write(reinterpret_cast<const char *>(plane->data()),
+                      plane->size());
+    }
+    return static_cast<bool>(outfile);
+}
+
+void Lightmap::clear() {
+    mapSize = 0;
+    hash    = 0;
+    for (auto plane : {&normalX, &normalY, &normalZ, &occlusionMap, &shadowMap,
+                       &lightMap}) {
+        plane->clear();
+    }
+}
+
+int Lightmap::size() const {
+    return mapSize;
+}
+
+bool Lightmap::empty() const {
+    return mapSize == 0;
+}
+
+uint64_t Lightmap::bakedKey() const {
+    return hash;
+}
+
+size_t Lightmap::texel(int x, int z) const {
+    x = std::clamp(x, 0, mapSize - 1);
+    z = std::clamp(z, 0, mapSize - 1);
+    return static_cast<size_t>(z) * mapSize + x;
+}
+
+float Lightmap::light(int x, int z) const {
+    return lightMap[texel(x, z)] / 255.f;
+}
+
+float Lightmap::occlusion(int x, int z) const {
+    return occlusionMap[texel(x, z)] / 255.f;
+}
+
+float Lightmap::shadow(int x, int z) const {
+    return shadowMap[texel(x, z)] / 255.f;
+}
+
+void Lightmap::normal(int x, int z, float &nx, float &ny, float &nz) const {
+    auto index = texel(x, z);
+    nx         = normalX[index] / 255.f * 2.f - 1.f;
+    ny         = normalY[index] / 255.f * 2.f - 1.f;
+    nz         = normalZ[index] / 255.f * 2.f - 1.f;
+}
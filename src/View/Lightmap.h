@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Engine/MemoryTracker.hpp"
+#include "Engine/ScratchArena.hpp"
+
+/**
+ * @brief Precomputed terrain lighting. bake() derives a normal map, horizon
+ * based ambient occlusion and a sun shadow mask from a heightfield and folds
+ * them into one light value per texel, so the renderer looks the light up
+ * instead of lighting every vertex each frame. bakeNormals() derives only the
+ * normal map, for meshes still lit by GL.
+ *
+ * Horizons come from sweeping lines across the grid in eight directions while
+ * keeping the upper convex hull of the samples already passed, which finds
+ * every texel's horizon in amortised constant time. The lines of a direction
+ * are swept in parallel, and the sun's horizon is taken from the sweep
+ * nearest its azimuth.
+ */
+class Lightmap {
+
+  public:
+    struct Parameters {
+        float scaleX = 1.f;
+        float scaleY = 1.f;
+        float scaleZ = 1.f;
+        // radians, azimuth measured from +x towards +z
+        float sunAzimuth   = 0.785f;
+        float sunElevation = 0.6f;
+        float ambient      = 0.45f;
+        float diffuse      = 0.75f;
+    };
+
+    // identifies a bake, so a cached one can be checked against the terrain
+    static uint64_t key(const float *heights, int size,
+                        const Parameters &parameters);
+
+    void bake(const float *heights, int size, const Parameters &parameters);
+    // only the normal map, the light planes stay empty and bakedKey() is 0
+    void bakeNormals(const float *heights, int size,
+                     const Parameters &parameters);
+    bool load(const std::string &filename, uint64_t expectedKey);
+    bool save(const std::string &filename) const;
+    void clear();
+
+    int size() const;
+    bool empty() const;
+    uint64_t bakedKey() const;
+
+    // all in 0 to 1, indices are clamped to the map
+    float light(int x, int z) const;
+    float occlusion(int x, int z) const;
+    float shadow(int x, int z) const;
+    // the surface normal, one byte per component so only roughly unit length
+    void normal(int x, int z, float &nx, float &ny, float &nz) const;
+
+  private:
+    using Plane =
+        SDLEngine::TrackedVector<uint8_t, SDLEngine::MemoryTag::Textures>;
+
+    struct HullPoint {
+        float distance;
+        float height;
+    };
+
+    size_t texel(int x, int z) const;
+    void sweep(const float *heights, int direction, float *occlusionSum,
+               float *sunVisibility, float sunElevation, HullPoint *hulls,
+               size_t slots) const;
+    void shade(const float *heights, const float *occlusionSum,
+               const float *sunVisibility);
+
+    Parameters params;
+    int mapSize  = 0;
+    uint64_t hash = 0;
+    // one byte plane per channel, row-major
+    Plane normalX;
+    Plane normalY;
+    Plane normalZ;
+    Plane occlusionMap;
+    Plane shadowMap;
+    Plane lightMap;
+    SDLEngine::ScratchArena scratch;
+};
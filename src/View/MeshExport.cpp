@@ -0,0 +1,473 @@
+#include "MeshExport.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "Engine/ParallelFor.hpp"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // aim for a few megabytes of encoded output per block of rows
+    constexpr size_t BLOCK_BYTES = 4 << 20;
+
+    // fixed width so the glTF bounds can be patched in place once known
+    constexpr auto BOUND_FORMAT      = "% .7e";
+    constexpr auto BOUND_PLACEHOLDER = " 0.0000000e+00";
+
+    struct Block {
+        std::vector<char> data;
+        std::vector<float> heights;
+        std::array<float, 3> min;
+        std::array<float, 3> max;
+
+        void reset() {
+            data.clear();
+            min.fill(std::numeric_limits<float>::max());
+            max.fill(std::numeric_limits<float>::lowest());
+        }
+        void bound(float x, float y, float z) {
+            min = {std::min(min[0], x), std::min(min[1], y), std::min(min[2], z)};
+            max = {std::max(max[0], x), std::max(max[1], y), std::max(max[2], z)};
+        }
+    };
+
+    class Output {
+      public:
+        explicit Output(const std::string &path)
+            : file(std::fopen(path.c_str(), "wb")) {}
+        Output(const Output &) = delete;
+        Output &operator=(const Output &) = delete;
+        ~Output() {
+            if (file != nullptr) {
+                std::fclose(file);
+            }
+        }
+
+        bool isOpen() const {
+            return file != nullptr;
+        }
+        void write(const void *data, size_t size) {
+            ok = ok && std::fwrite(data, 1, size, file) == size;
+            bytes += size;
+        }
+        void write(const std::string &text) {
+            write(text.data(), text.size());
+        }
+        // overwrite bytes already written, then return to the end
+        void patch(long offset, const std::string &text) {
+            ok = ok && std::fseek(file, offset, SEEK_SET) == 0;
+            ok = ok && std::fwrite(text.data(), 1, text.size(), file) ==
+                           text.size();
+            ok = ok && std::fseek(file, 0, SEEK_END) == 0;
+        }
+        bool close() {
+            ok   = ok && std::fclose(file) == 0;
+            file = nullptr;
+            return ok;
+        }
+
+        uint64_t bytes = 0;
+        std::array<float, 3> min;
+        std::array<float, 3> max;
+
+      private:
+        std::FILE *file = nullptr;
+        bool ok         = true;
+    };
+
+    template <typename... Args>
+    void appendText(std::vector<char> &out, const char *format, Args... args) {
+        char text[96];
+        auto length = std::snprintf(text, sizeof(text), format, args...);
+        out.insert(out.end(), text, text + length);
+    }
+
+    // binary PLY and GLB are little endian regardless of the host
+    void appendU32(std::vector<char> &out, uint32_t value) {
+        char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8),
+                         static_cast<char>(value >> 16),
+                         static_cast<char>(value >> 24)};
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    void appendF32(std::vector<char> &out, float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        appendU32(out, bits);
+    }
+
+    std::string u32String(uint32_t value) {
+        std::vector<char> bytes;
+        appendU32(bytes, value);
+        return std::string(bytes.begin(), bytes.end());
+    }
+
+    /**
+     * Encodes rowCount rows in blocks of rowsPerBlock with encode(first,
+     * last, block), a batch of blocks at a time, and writes each batch out in
+     * order. Only one batch of encoded output is ever held in memory.
+     */
+    template <typename Encode>
+    void streamRows(Output &out, size_t rowCount, size_t rowsPerBlock,
+                    bool parallel, Encode &&encode) {
+        auto blockCount = (rowCount + rowsPerBlock - 1) / rowsPerBlock;
+        auto batchSize  = parallel ? SDLEngine::workerCount() * 2u : 1u;
+        std::vector<Block> blocks(std::min<size_t>(batchSize, blockCount));
+
+        for (size_t batch = 0; batch < blockCount; batch += blocks.size()) {
+            auto count  = std::min(blocks.size(), blockCount - batch);
+            auto encodeRange = [&](size_t begin, size_t end) {
+                for (auto i = begin; i < end; i++) {
+                    auto first = (batch + i) * rowsPerBlock;
+                    blocks[i].reset();
+                    encode(first, std::min(first + rowsPerBlock, rowCount),
+                           blocks[i]);
+                }
+            };
+            if (parallel) {
+                SDLEngine::parallelFor(count, 1, encodeRange);
+            } else {
+                encodeRange(0, count);
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                out.write(blocks[i].data.data(), blocks[i].data.size());
+                for (int axis = 0; axis < 3; axis++) {
+                    out.min[axis] = std::min(out.min[axis], blocks[i].min[axis]);
+                    out.max[axis] = std::max(out.max[axis], blocks[i].max[axis]);
+                }
+            }
+        }
+    }
+
+    /**
+     * Counts and block sizes shared by every mesh source. A source streams
+     * its vertices with vertices(first, last, block, emit) and its triangles,
+     * as vertex index triples, with triangles(first, last, block, emit), each
+     * over its own row count.
+     */
+    struct MeshLayout {
+        uint64_t vertexCount;
+        uint64_t triangleCount;
+        size_t vertexRows;
+        size_t vertexRowsPerBlock;
+        size_t triangleRows;
+        size_t triangleRowsPerBlock;
+    };
+
+    // a regular grid pulled a row at a time from a RowSource
+    struct GridMesh : MeshLayout {
+        const MeshExport::RowSource *rows;
+        uint32_t width;
+        float scaleX, scaleY, scaleZ;
+
+        template <typename Emit>
+        void vertices(size_t first, size_t last, Block &block,
+                      Emit &&emit) const {
+            block.heights.resize(width);
+            for (auto z = first; z < last; z++) {
+                (*rows)(static_cast<int>(z), block.heights.data());
+                for (uint32_t x = 0; x < width; x++) {
+                    emit(block, x * scaleX, block.heights[x] * scaleY,
+                         z * scaleZ);
+                }
+            }
+        }
+
+        // the same two triangles per quad as Terrain::createTriangles,
+        // counter-clockwise seen from +y so the faces point up
+        template <typename Emit>
+        void triangles(size_t first, size_t last, Block &block,
+                       Emit &&emit) const {
+            for (auto z = first; z < last; z++) {
+                for (uint32_t x = 0; x + 1 < width; x++) {
+                    auto a = static_cast<uint32_t>(z * width + x);
+                    auto d = a + width;
+                    emit(block, a, d + 1, a + 1);
+                    emit(block, a, d, d + 1);
+                }
+            }
+        }
+    };
+
+    // vertices and an index buffer of three vertices per triangle
+    struct IndexedMesh : MeshLayout {
+        const float *positions;
+        const uint32_t *indices;
+
+        template <typename Emit>
+        void vertices(size_t first, size_t last, Block &block,
+                      Emit &&emit) const {
+            for (auto i = first * 3; i < last * 3; i += 3) {
+                emit(block, positions[i], positions[i + 1], positions[i + 2]);
+            }
+        }
+
+        template <typename Emit>
+        void triangles(size_t first, size_t last, Block &block,
+                       Emit &&emit) const {
+            for (auto i = first * 3; i < last * 3; i += 3) {
+                emit(block, indices[i], indices[i + 1], indices[i + 2]);
+            }
+        }
+    };
+
+    template <typename Mesh>
+    void writeObj(Output &out, const Mesh &mesh, bool parallel) {
+        out.write("# TerrainGeneration\n");
+        streamRows(out, mesh.vertexRows, mesh.vertexRowsPerBlock, parallel,
+                   [&](size_t first, size_t last, Block &block) {
+                       mesh.vertices(first, last, block,
+                                     [](Block &b, float x, float y, float z) {
+                                         appendText(b.data, "v %.6g %.6g %.6g\n",
+                                                    x, y, z);
+                                     });
+                   });
+        streamRows(out, mesh.triangleRows, mesh.triangleRowsPerBlock, parallel,
+                   [&](size_t first, size_t last, Block &block) {
+                       mesh.triangles(
+                           first, last, block,
+                           [](Block &b, uint32_t i, uint32_t j, uint32_t k) {
+                               appendText(b.data, "f %u %u %u\n", i + 1,
+                                          j + 1, k + 1);
+                           });
+                   });
+    }
+
+    template <typename Mesh>
+    void writePly(Output &out, const Mesh &mesh, bool parallel) {
+        char header[320];
+        std::snprintf(header, sizeof(header),
+                      "ply\n"
+                      "format binary_little_endian 1.0\n"
+                      "comment TerrainGeneration\n"
+                      "element vertex %llu\n"
+                      "property float x\n"
+                      "property float y\n"
+                      "property float z\n"
+                      "element face %llu\n"
+                      "property list uchar uint vertex_indices\n"
+                      "end_header\n",
+                      static_cast<unsigned long long>(mesh.vertexCount),
+                      static_cast<unsigned long long>(mesh.triangleCount));
+        out.write(header);
+        streamRows(out, mesh.vertexRows, mesh.vertexRowsPerBlock, parallel,
+                   [&](size_t first, size_t last, Block &block) {
+                       mesh.vertices(first, last, block,
+                                     [](Block &b, float x, float y, float z) {
+                                         appendF32(b.data, x);
+                                         appendF32(b.data, y);
+                                         appendF32(b.data, z);
+                                     });
+                   });
+        streamRows(out, mesh.triangleRows, mesh.triangleRowsPerBlock, parallel,
+                   [&](size_t first, size_t last, Block &block) {
+                       mesh.triangles(
+                           first, last, block,
+                           [](Block &b, uint32_t i, uint32_t j, uint32_t k) {
+                               b.data.push_back(3);
+                               appendU32(b.data, i);
+                               appendU32(b.data, j);
+                               appendU32(b.data, k);
+                           });
+                   });
+    }
+
+    template <typename Mesh>
+    bool writeGlb(Output &out, const Mesh &mesh, bool parallel) {
+        auto positionBytes = mesh.vertexCount * 12;
+        auto indexBytes    = mesh.triangleCount * 12;
+        auto binaryBytes   = positionBytes + indexBytes;
+
+        // the accessor bounds are written as placeholders and patched once
+        // every vertex has been streamed
+        std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":"
+                           "\"TerrainGeneration\"},\"scene\":0,\"scenes\":"
+                           "[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+                           "\"meshes\":[{\"primitives\":[{\"attributes\":"
+                           "{\"POSITION\":0},\"indices\":1}]}],"
+                           "\"buffers\":[{\"byteLength\":" +
+                           std::to_string(binaryBytes) +
+                           "}],\"bufferViews\":[{\"buffer\":0,\"byteOffset\":"
+                           "0,\"byteLength\":" +
+                           std::to_string(positionBytes) +
+                           ",\"target\":34962},{\"buffer\":0,\"byteOffset\":" +
+                           std::to_string(positionBytes) +
+                           ",\"byteLength\":" + std::to_string(indexBytes) +
+                           ",\"target\":34963}],\"accessors\":[{\"bufferView\""
+                           ":0,\"componentType\":5126,\"count\":" +
+                           std::to_string(mesh.vertexCount) +
+                           ",\"type\":\"VEC3\",\"min\":[";
+        std::array<size_t, 6> bounds;
+        for (int i = 0; i < 6; i++) {
+            if (i == 3) {
+                json += "],\"max\":[";
+            } else if (i != 0) {
+                json += ",";
+            }
+            bounds[i] = json.size();
+            json += BOUND_PLACEHOLDER;
+        }
+        json += "]},{\"bufferView\":1,\"componentType\":5125,\"count\":" +
+                std::to_string(mesh.triangleCount * 3) +
+                ",\"type\":\"SCALAR\"}]}";
+        json.resize((json.size() + 3) & ~size_t{3}, ' ');
+
+        auto total = 12 + 8 + json.size() + 8 + binaryBytes;
+        if (total > std::numeric_limits<uint32_t>::max()) {
+            std::cerr << "Mesh too large for GLB: " << total << " bytes"
+                      << std::endl;
+            return false;
+        }
+
+        out.write("glTF");
+        out.write(u32String(2));
+        out.write(u32String(static_cast<uint32_t>(total)));
+        out.write(u32String(static_cast<uint32_t>(json.size())));
+        out.write("JSON");
+        out.write(json);
+        out.write(u32String(static_cast<uint32_t>(binaryBytes)));
+        out.write(std::string("BIN\0", 4));
+
+        streamRows(out, mesh.vertexRows, mesh.vertexRowsPerBlock, parallel,
+                   [&](size_t first, size_t last, Block &block) {
+                       mesh.vertices(first, last, block,
+                                     [](Block &b, float x, float y, float z) {
+                                         appendF32(b.data, x);
+                                         appendF32(b.data, y);
+                                         appendF32(b.data, z);
+                                         b.bound(x, y, z);
+                                     });
+                   });
+        streamRows(out, mesh.triangleRows, mesh.triangleRowsPerBlock, parallel,
+                   [&](size_t first, size_t last, Block &block) {
+                       mesh.triangles(
+                           first, last, block,
+                           [](Block &b, uint32_t i, uint32_t j, uint32_t k) {
+                               appendU32(b.data, i);
+                               appendU32(b.data, j);
+                               appendU32(b.data, k);
+                           });
+                   });
+
+        for (int i = 0; i < 6; i++) {
+            char text[32];
+            std::snprintf(text, sizeof(text), BOUND_FORMAT,
+                          i < 3 ? out.min[i] : out.max[i - 3]);
+            out.patch(static_cast<long>(20 + bounds[i]), text);
+        }
+        return true;
+    }
+
+    template <typename Mesh>
+    bool writeMesh(const std::string &path, MeshExport::Format format,
+                   const Mesh &mesh, bool parallel,
+                   MeshExport::Stats &stats) {
+        auto start = Clock::now();
+        if (mesh.vertexCount > std::numeric_limits<uint32_t>::max()) {
+            std::cerr << "Too many vertices to export: " << mesh.vertexCount
+                      << std::endl;
+            return false;
+        }
+
+        Output out(path);
+        if (!out.isOpen()) {
+            std::cerr << "Cannot open file :" << path << std::endl;
+            return false;
+        }
+        out.min.fill(std::numeric_limits<float>::max());
+        out.max.fill(std::numeric_limits<float>::lowest());
+
+        auto written = true;
+        switch (format) {
+            case MeshExport::Format::Obj: writeObj(out, mesh, parallel); break;
+            case MeshExport::Format::Ply: writePly(out, mesh, parallel); break;
+            case MeshExport::Format::Glb:
+                written = writeGlb(out, mesh, parallel);
+                break;
+        }
+        written = out.close() && written;
+
+        stats.bytes   = out.bytes;
+        stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (!written) {
+            std::cerr << "Failed to write " << path << std::endl;
+        }
+        return written;
+    }
+}
+
+double MeshExport::Stats::megabytesPerSecond() const {
+    return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+bool MeshExport::formatFromPath(const std::string &path, Format &format) {
+    auto dot = path.find_last_of('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    auto extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (extension == "obj") {
+        format = Format::Obj;
+    } else if (extension == "ply") {
+        format = Format::Ply;
+    } else if (extension == "glb") {
+        format = Format::Glb;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool MeshExport::writeHeightfield(const std::string &path, Format format,
+                                  int size, const RowSource &rows,
+                                  float scaleX, float scaleY, float scaleZ,
+                                  Stats &stats, bool parallel) {
+    if (size < 2) {
+        return false;
+    }
+    auto width = static_cast<uint64_t>(size);
+
+    GridMesh mesh;
+    mesh.vertexCount   = width * width;
+    mesh.triangleCount = 2 * (width - 1) * (width - 1);
+    mesh.vertexRows    = width;
+    mesh.triangleRows  = width - 1;
+    // roughly 32 bytes per encoded vertex and 64 per pair of triangles
+    mesh.vertexRowsPerBlock   = std::max<size_t>(BLOCK_BYTES / (width * 32), 1);
+    mesh.triangleRowsPerBlock = std::max<size_t>(BLOCK_BYTES / (width * 64), 1);
+    mesh.rows                 = &rows;
+    mesh.width                = static_cast<uint32_t>(width);
+    mesh.scaleX               = scaleX;
+    mesh.scaleY               = scaleY;
+    mesh.scaleZ               = scaleZ;
+    return writeMesh(path, format, mesh, parallel, stats);
+}
+
+bool MeshExport::writeIndexed(const std::string &path, Format format,
+                              const float *positions, size_t vertexCount,
+                              const uint32_t *indices, size_t triangleCount,
+                              Stats &stats) {
+    constexpr size_t ITEMS_PER_BLOCK = 1 << 16;
+
+    IndexedMesh mesh;
+    mesh.vertexCount          = vertexCount;
+    mesh.triangleCount        = triangleCount;
+    mesh.vertexRows           = vertexCount;
+    mesh.triangleRows         = triangleCount;
+    mesh.vertexRowsPerBlock   = ITEMS_PER_BLOCK;
+    mesh.triangleRowsPerBlock = ITEMS_PER_BLOCK;
+    mesh.positions            = positions;
+    mesh.indices              = indices;
+    return writeMesh(path, format, mesh, true, stats);
+}
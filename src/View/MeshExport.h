@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/**
+ * @brief Streaming mesh writers for Wavefront OBJ, binary PLY and binary glTF
+ * (GLB). Heightfields are pulled from a row callback a block of rows at a
+ * time and written with large sequential writes, so the full grid or mesh
+ * never has to exist in memory; when parallel is set, the blocks of each
+ * batch are produced and encoded on worker threads and written in order.
+ */
+namespace MeshExport {
+
+    enum class Format { Obj, Ply, Glb };
+
+    struct Stats {
+        uint64_t bytes = 0;
+        double seconds = 0.0;
+
+        double megabytesPerSecond() const;
+    };
+
+    // fills heights with the size samples of row z, may be called from
+    // several threads at once when exporting in parallel
+    using RowSource = std::function<void(int z, float *heights)>;
+
+    bool formatFromPath(const std::string &path, Format &format);
+
+    bool writeHeightfield(const std::string &path, Format format, int size,
+                          const RowSource &rows, float scaleX, float scaleY,
+                          float scaleZ, Stats &stats, bool parallel = true);
+
+    // positions holds an xyz vertex each and indices three vertex indices
+    // per triangle, so vertices shared by triangles are written once
+    bool writeIndexed(const std::string &path, Format format,
+                      const float *positions, size_t vertexCount,
+                      const uint32_t *indices, size_t triangleCount,
+                      Stats &stats);
+}
@@ -0,0 +1,285 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+
+#include "Engine/ParallelFor.hpp"
+
+namespace {
+    // depth of the subtrees handed out to worker threads, 2^(depth + 1) roots
+    constexpr int TASK_DEPTH = 8;
+    // triangles per task in build(), coarse levels smaller than this run
+    // on the calling thread
+    constexpr size_t MIN_LEVEL_GRAIN = 4096;
+
+    // integer division rounding towards negative infinity
+    int floorDiv(int numerator, int denominator) {
+        auto quotient = numerator / denominator;
+        if ((numerator % denominator != 0) &&
+            ((numerator < 0) != (denominator < 0))) {
+            --quotient;
+        }
+        return quotient;
+    }
+}
+
+void MeshSimplifier::build(const Heightfield &field) {
+    fieldSize = field.size();
+    if (fieldSize < 2) {
+        tileSize = gridSize = 0;
+        heights.clear();
+        errors.clear();
+        return;
+    }
+
+    // the hierarchy needs a (2^k + 1)^2 grid, pad by repeating the last
+    // row and column of the heightfield
+    tileSize = 1;
+    while (tileSize < fieldSize - 1) {
+        tileSize <<= 1;
+    }
+    gridSize = tileSize + 1;
+    heights.resize(static_cast<size_t>(gridSize) * gridSize);
+    for (int z = 0; z < gridSize; z++) {
+        auto row = &heights[static_cast<size_t>(z) * gridSize];
+        field.readRow(std::min(z, fieldSize - 1), 0, fieldSize, row);
+        std::fill(row + fieldSize, row + gridSize, row[fieldSize - 1]);
+    }
+    errors.assign(heights.size(), 0.f);
+
+    // visit the hierarchy a level at a time from the finest up, so a vertex's
+    // error already includes its children's when its parent reads it. A
+    // vertex is only split on if one of the two triangles sharing it as their
+    // hypotenuse midpoint, or anything that depends on it, deviates from the
+    // full resolution heightfield by more than the bound. Triangles within a
+    // level are independent; only the merge into shared midpoints is serial.
+    auto levels = 0;
+    while ((int64_t{2} << levels) - 2 < static_cast<int64_t>(tileSize) * tileSize * 2 - 2) {
+        ++levels;
+    }
+    for (auto level = levels - 1; level >= 0; level--) {
+        auto first = (int64_t{2} << level) - 2;
+        auto count = static_cast<size_t>(int64_t{2} << level);
+        auto leaf  = level == levels - 1;
+        levelErrors.resize(count);
+        auto grain = std::max(count / (SDLEngine::workerCount() * 8),
+                              MIN_LEVEL_GRAIN);
+        SDLEngine::parallelFor(count, grain, [&](size_t begin, size_t end) {
+            for (auto k = begin; k < end; k++) {
+                int ax, az, bx, bz, cx, cz;
+                triangleCoords(first + k, ax, az, bx, bz, cx, cz);
+                auto error = triangleError(ax, az, bx, bz, cx, cz);
+                if (!leaf) {
+                    auto left  = static_cast<size_t>((az + cz) >> 1) * gridSize +
+                                ((ax + cx) >> 1);
+                    auto right = static_cast<size_t>((bz + cz) >> 1) * gridSize +
+                                 ((bx + cx) >> 1);
+                    error = std::max({error, errors[left], errors[right]});
+                }
+                levelErrors[k] = error;
+            }
+        });
+        for (size_t k = 0; k < count; k++) {
+            int ax, az, bx, bz, cx, cz;
+            triangleCoords(first + k, ax, az, bx, bz, cx, cz);
+            auto middle    = static_cast<size_t>((az + bz) >> 1) * gridSize +
+                          ((ax + bx) >> 1);
+            errors[middle] = std::max(errors[middle], levelErrors[k]);
+        }
+    }
+}
+
+void MeshSimplifier::extract(float maxError, std::vector<Triangle> &out) {
+    out.clear();
+    if (gridSize == 0) {
+        return;
+    }
+
+    // split the two root triangles into independent subtrees, each subtree
+    // keeps its capacity from the last extract
+    subtreeRoots.clear();
+    split(0, 0, tileSize, tileSize, tileSize, 0, 0, maxError, subtreeRoots);
+    split(tileSize, tileSize, 0, 0, 0, tileSize, 0, maxError, subtreeRoots);
+
+    subtrees.resize(subtreeRoots.size());
+    SDLEngine::parallelFor(
+        subtreeRoots.size(), 1, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; i++) {
+                const auto &root = subtreeRoots[i];
+                subtrees[i].clear();
+                refine(root.ax, root.az, root.bx, root.bz, root.cx, root.cz,
+                       maxError, subtrees[i]);
+            }
+        });
+
+    size_t total = 0;
+    for (const auto &subtree : subtrees) {
+        total += subtree.size();
+    }
+    out.reserve(total);
+    for (const auto &subtree : subtrees) {
+        out.insert(out.end(), subtree.begin(), subtree.end());
+    }
+}
+
+void MeshSimplifier::triangleCoords(int64_t index, int &ax, int &az, int &bx,
+                                    int &bz, int &cx, int &cz) const {
+    // triangles are numbered level by level, the bits of the id below the
+    // leading one choose the left or right child on the way down from a root
+    auto id = index + 2;
+    ax = az = bx = bz = cx = cz = 0;
+    if (id & 1) {
+        bx = bz = cx = tileSize;
+    } else {
+        ax = az = cz = tileSize;
+    }
+    while ((id >>= 1) > 1) {
+        auto mx = (ax + bx) >> 1;
+        auto mz = (az + bz) >> 1;
+        if (id & 1) {
+            bx = ax;
+            bz = az;
+            ax = cx;
+            az = cz;
+        } else {
+            ax = bx;
+            az = bz;
+            bx = cx;
+            bz = cz;
+        }
+        cx = mx;
+        cz = mz;
+    }
+}
+
+float MeshSimplifier::triangleError(int ax, int az, int bx, int bz, int cx,
+                                    int cz) const {
+    // largest vertical distance between the triangle's plane and any grid
+    // point inside it. The barycentric weights are linear in x along a row,
+    // so each row is clipped to the span where all three are non-negative
+    // and the plane is evaluated directly across that span.
+    //
+    // emit() pulls padding vertices back onto the last row and column, which
+    // changes the plane of any triangle reaching into the padding. Those are
+    // always split, down to triangles wholly inside the heightfield or wholly
+    // in the padding, which collapse and are dropped.
+    auto last = fieldSize - 1;
+    if (std::min({ax, bx, cx}) >= last || std::min({az, bz, cz}) >= last) {
+        return 0.f;
+    }
+    if (std::max({ax, bx, cx}) > last || std::max({az, bz, cz}) > last) {
+        return std::numeric_limits<float>::max();
+    }
+    auto area = (bz - cz) * (ax - cx) + (cx - bx) * (az - cz);
+    if (area == 0) {
+        return 0.f;
+    }
+    auto sign    = area > 0 ? 1 : -1;
+    auto ha      = heights[static_cast<size_t>(az) * gridSize + ax];
+    auto hb      = heights[static_cast<size_t>(bz) * gridSize + bx];
+    auto hc      = heights[static_cast<size_t>(cz) * gridSize + cx];
+    auto inverse = 1.f / static_cast<float>(area);
+
+    // weight(x) = slope * (x - cx) + intercept, for each corner
+    int slopes[3] = {bz - cz, cz - az, 0};
+    slopes[2]     = -slopes[0] - slopes[1];
+    auto planeSlope =
+        (slopes[0] * ha + slopes[1] * hb + slopes[2] * hc) * inverse;
+
+    auto error = 0.f;
+    for (int z = std::min({az, bz, cz}); z <= std::max({az, bz, cz}); z++) {
+        int intercepts[3] = {(cx - bx) * (z - cz), (ax - cx) * (z - cz), 0};
+        intercepts[2]     = area - intercepts[0] - intercepts[1];
+
+        auto low  = std::min({ax, bx, cx});
+        auto high = std::max({ax, bx, cx});
+        for (int w = 0; w < 3; w++) {
+            auto slope     = slopes[w] * sign;
+            auto intercept = intercepts[w] * sign;
+            if (slope > 0) {
+                // x - cx >= ceil(-intercept / slope)
+                low = std::max(low, cx + floorDiv(-intercept + slope - 1, slope));
+            } else if (slope < 0) {
+                // x - cx <= floor(intercept / -slope)
+                high = std::min(high, cx + floorDiv(intercept, -slope));
+            } else if (intercept < 0) {
+                low = high + 1;
+            }
+        }
+
+        auto row       = &heights[static_cast<size_t>(z) * gridSize];
+        auto planeBase = (intercepts[0] * ha + intercepts[1] * hb +
+                          intercepts[2] * hc) *
+                             inverse -
+                         cx * planeSlope;
+        for (int x = low; x <= high; x++) {
+            error = std::max(error, std::fabs(planeBase + x * planeSlope - row[x]));
+        }
+    }
+    return error;
+}
+
+int MeshSimplifier::size() const {
+    return fieldSize;
+}
+
+bool MeshSimplifier::needsSplit(int ax, int az, int bx, int bz, int cx, int cz,
+                                float maxError) const {
+    auto mx = (ax + bx) >> 1;
+    auto mz = (az + bz) >> 1;
+    return std::abs(ax - cx) + std::abs(az - cz) > 1 &&
+           errors[static_cast<size_t>(mz) * gridSize + mx] > maxError;
+}
+
+void MeshSimplifier::split(int ax, int az, int bx, int bz, int cx, int cz,
+                           int depth, float maxError,
+                           std::vector<Triangle> &roots) const {
+    if (depth == TASK_DEPTH || !needsSplit(ax, az, bx, bz, cx, cz, maxError)) {
+        roots.push_back({ax, az, bx, bz, cx, cz});
+        return;
+    }
+    auto mx = (ax + bx) >> 1;
+    auto mz = (az + bz) >> 1;
+    split(cx, cz, ax, az, mx, mz, depth + 1, maxError, roots);
+    split(bx, bz, cx, cz, mx, mz, depth + 1, maxError, roots);
+}
+
+void MeshSimplifier::refine(int ax, int az, int bx, int bz, int cx, int cz,
+                            float maxError, std::vector<Triangle> &out) const {
+    if (!needsSplit(ax, az, bx, bz, cx, cz, maxError)) {
+        emit(ax, az, bx, bz, cx, cz, out);
+        return;
+    }
+    auto mx = (ax + bx) >> 1;
+    auto mz = (az + bz) >> 1;
+    refine(cx, cz, ax, az, mx, mz, maxError, out);
+    refine(bx, bz, cx, cz, mx, mz, maxError, out);
+}
+
+void MeshSimplifier::emit(int ax, int az, int bx, int bz, int cx, int cz,
+                          std::vector<Triangle> &out) const {
+    // pull the padding back onto the last row and column; every vertex moves
+    // the same way so shared edges stay shared, and triangles lying wholly
+    // in the padding collapse and are dropped
+    auto last = fieldSize - 1;
+    ax = std::min(ax, last);
+    az = std::min(az, last);
+    bx = std::min(bx, last);
+    bz = std::min(bz, last);
+    cx = std::min(cx, last);
+    cz = std::min(cz, last);
+
+    auto area = (bx - ax) * (cz - az) - (bz - az) * (cx - ax);
+    if (area == 0) {
+        return;
+    }
+    // a negative cross product in x and z is counter-clockwise seen from +y
+    if (area < 0) {
+        out.push_back({ax, az, bx, bz, cx, cz});
+    } else {
+        out.push_back({ax, az, cx, cz, bx, bz});
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Heightfield.h"
+
+/**
+ * @brief Adaptive terrain triangulation using a right-triangulated irregular
+ * network (RTIN). build() computes, for every vertex of the triangle
+ * hierarchy, the largest vertical error introduced by not splitting at it,
+ * including the errors of everything beneath it. extract() then refines the
+ * two root triangles only where that error exceeds the requested bound.
+ *
+ * The error map is global, so independent subtrees can be extracted on
+ * different threads and still agree on every shared edge: the result is
+ * always watertight.
+ */
+class MeshSimplifier {
+
+  public:
+    // a triangle in grid coordinates, wound counter-clockwise seen from +y
+    // like createTriangles, so its normal points up
+    struct Triangle {
+        int ax, az;
+        int bx, bz;
+        int cx, cz;
+    };
+
+    void build(const Heightfield &field);
+    void extract(float maxError, std::vector<Triangle> &out);
+    int size() const;
+
+  private:
+    void triangleCoords(int64_t index, int &ax, int &az, int &bx, int &bz,
+                        int &cx, int &cz) const;
+    float triangleError(int ax, int az, int bx, int bz, int cx, int cz) const;
+    bool needsSplit(int ax, int az, int bx, int bz, int cx, int cz,
+                    float maxError) const;
+    void split(int ax, int az, int bx, int bz, int cx, int cz, int depth,
+               float maxError, std::vector<Triangle> &roots) const;
+    void refine(int ax, int az, int bx, int bz, int cx, int cz, float maxError,
+                std::vector<Triangle> &out) const;
+    void emit(int ax, int az, int bx, int bz, int cx, int cz,
+              std::vector<Triangle> &out) const;
+
+    int fieldSize = 0;
+    int tileSize  = 0;
+    int gridSize  = 0;
+    SDLEngine::TrackedVector<float, SDLEngine::MemoryTag::Mesh> heights;
+    SDLEngine::TrackedVector<float, SDLEngine::MemoryTag::Mesh> errors;
+    // kept between calls so rebuilding the same terrain reuses them
+    SDLEngine::TrackedVector<float, SDLEngine::MemoryTag::Mesh> levelErrors;
+    std::vector<Triangle> subtreeRoots;
+    std::vector<std::vector<Triangle>> subtrees;
+};
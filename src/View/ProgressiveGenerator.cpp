@@ -0,0 +1,177 @@
+#include "ProgressiveGenerator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <random>
+#include <utility>
+
+#include "TerrainKernels.h"
+
+namespace {
+    // bilinearly resample a size * size grid to targetSize * targetSize
+    void upsample(const float *source, int size, float *target,
+                  int targetSize) {
+        auto ratio = static_cast<float>(size) / targetSize;
+        for (int z = 0; z < targetSize; z++) {
+            auto sz = std::clamp((z + 0.5f) * ratio - 0.5f, 0.f, size - 1.f);
+            auto z0 = static_cast<int>(sz);
+            auto z1 = std::min(z0 + 1, size - 1);
+            auto fz = sz - z0;
+            auto r0 = source + static_cast<size_t>(z0) * size;
+            auto r1 = source + static_cast<size_t>(z1) * size;
+            auto out = target + static_cast<size_t>(z) * targetSize;
+            for (int x = 0; x < targetSize; x++) {
+                auto sx = std::clamp((x + 0.5f) * ratio - 0.5f, 0.f, size - 1.f);
+                auto x0 = static_cast<int>(sx);
+                auto x1 = std::min(x0 + 1, size - 1);
+                auto fx = sx - x0;
+                auto top    = r0[x0] + (r0[x1] - r0[x0]) * fx;
+                auto bottom = r1[x0] + (r1[x1] - r1[x0]) * fx;
+                out[x]      = top + (bottom - top) * fz;
+            }
+        }
+    }
+
+    // the erosion filter works per sample, so weaken it on coarse levels to
+    // keep the smoothing distance the same in world units
+    float levelWeight(float weight, int size, int levelSize) {
+        auto factor = static_cast<float>(size) / levelSize;
+        return std::clamp(1.f - factor * (1.f - weight), 0.f, weight);
+    }
+}
+
+ProgressiveGenerator::~ProgressiveGenerator() {
+    cancel();
+}
+
+void ProgressiveGenerator::start(const Parameters &parameters) {
+    cancel();
+    if (parameters.size <= 0) {
+        return;
+    }
+    params = parameters;
+
+    // draw every fault line up front, in grid-independent coordinates, so each
+    // level cuts exactly the same lines as a full resolution run would
+    auto engine = std::mt19937{params.random ? static_cast<uint32_t>(time(NULL))
+                                             : 1u};
+    auto pick   = std::uniform_int_distribution<int>{0, params.size - 1};
+    auto scale  = 1.f / params.size;
+    faults.clear();
+    for (int j = 0; j < params.iterations; j++) {
+        int x1 = pick(engine), z1 = pick(engine), x2, z2;
+        do {
+            x2 = pick(engine);
+            z2 = pick(engine);
+        } while (x2 == x1 && z2 == z1);
+        auto displacement =
+            params.maxHeight -
+            ((params.maxHeight - params.minHeight) * j) / params.iterations;
+        faults.push_back({(x1 + 0.5f) * scale, (z1 + 0.5f) * scale,
+                          (x2 + 0.5f) * scale, (z2 + 0.5f) * scale,
+                          displacement});
+    }
+
+    cancelled = false;
+    busy      = true;
+    worker    = std::thread(&ProgressiveGenerator::run, this);
+}
+
+void ProgressiveGenerator::cancel() {
+    cancelled = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = false;
+}
+
+bool ProgressiveGenerator::poll(Heightfield &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pending) {
+        return false;
+    }
+    out     = std::move(latest);
+    pending = false;
+    return true;
+}
+
+bool ProgressiveGenerator::running() const {
+    return busy;
+}
+
+int ProgressiveGenerator::targetSize() const {
+    return params.size;
+}
+
+void ProgressiveGenerator::run() {
+    // level sizes, halving down from the full size to the first level size
+    std::vector<int> levels = {params.size};
+    while (levels.back() / 2 >= std::max(params.firstLevelSize, 2)) {
+        levels.push_back(levels.back() / 2);
+    }
+    std::reverse(levels.begin(), levels.end());
+
+    scratch.reset();
+    float *previous  = nullptr;
+    int previousSize = 0;
+    size_t next      = 0;
+    for (size_t level = 0; level < levels.size(); level++) {
+        auto size    = levels[level];
+        auto count   = static_cast<size_t>(size) * size;
+        auto heights = scratch.allocate<float>(count);
+        if (previous != nullptr) {
+            upsample(previous, previousSize, heights, size);
+        } else {
+            std::fill(heights, heights + count, 0.f);
+        }
+
+        // each level cuts its share of the faults, largest displacements first
+        auto last   = level + 1 == levels.size();
+        auto end    = last ? faults.size()
+                           : faults.size() * (level + 1) / levels.size();
+        auto weight = levelWeight(params.weight, params.size, size);
+        for (; next < end; next++) {
+            if (cancelled) {
+                busy = false;
+                return;
+            }
+            const auto &fault = faults[next];
+            TerrainKernels::applyFault(
+                heights, size, static_cast<int>(fault.x1 * size),
+                static_cast<int>(fault.z1 * size),
+                static_cast<int>(fault.x2 * size),
+                static_cast<int>(fault.z2 * size),
+                static_cast<float>(fault.displacement));
+            TerrainKernels::addFilter(heights, weight, size);
+        }
+
+        if (last) {
+            for (int i = 0; i < params.postSmoothingIterations; i++) {
+                TerrainKernels::addFilter(heights, params.weight, size);
+            }
+            TerrainKernels::normalise(heights, size);
+            publish(heights, size);
+        } else {
+            // normalise a copy for display, the next level refines the original
+            auto display = scratch.allocate<float>(count);
+            std::copy(heights, heights + count, display);
+            TerrainKernels::normalise(display, size);
+            publish(display, size);
+        }
+        previous     = heights;
+        previousSize = size;
+    }
+    busy = false;
+}
+
+void ProgressiveGenerator::publish(const float *heights, int size) {
+    // build the tiles outside the lock so poll() never waits on them
+    Heightfield level;
+    level.assign(heights, size);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    latest  = std::move(level);
+    pending = true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Engine/ScratchArena.hpp"
+#include "Heightfield.h"
+
+/**
+ * @brief Runs fault formation on a background thread as a series of levels,
+ * starting at a coarse grid and doubling up to the requested size. Each level
+ * upsamples the previous one and cuts the next share of the fault lines into
+ * it, so the coarse levels hold the large displacements and the finer levels
+ * add detail. Every finished level is published for the render thread to
+ * pick up with poll().
+ */
+class ProgressiveGenerator {
+
+  public:
+    struct Parameters {
+        int iterations              = 256;
+        int size                    = 512;
+        int minHeight               = 0;
+        int maxHeight               = 255;
+        float weight                = 0.1f;
+        int postSmoothingIterations = 20;
+        bool random                 = false;
+        int firstLevelSize          = 64;
+    };
+
+    ProgressiveGenerator() = default;
+    ProgressiveGenerator(const ProgressiveGenerator &) = delete;
+    ProgressiveGenerator &operator=(const ProgressiveGenerator &) = delete;
+    ~ProgressiveGenerator();
+
+    void start(const Parameters &parameters);
+    void cancel();
+    bool poll(Heightfield &out);
+    bool running() const;
+    int targetSize() const;
+
+  private:
+    struct Fault {
+        float x1, z1, x2, z2;
+        int displacement;
+    };
+
+    void run();
+    void publish(const float *heights, int size);
+
+    Parameters params;
+    std::vector<Fault> faults;
+    SDLEngine::ScratchArena scratch;
+
+    std::thread worker;
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> busy{false};
+
+    std::mutex mutex;
+    Heightfield latest;
+    bool pending = false;
+};
@@ -0,0 +1,553 @@
+#include "Scatter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "Engine/ParallelFor.hpp"
+
+namespace {
+    constexpr int MIN_CHUNK_SAMPLES = 32;
+    // candidates tried around an active sample before it is retired
+    constexpr int ATTEMPTS = 8;
+    // fresh seeds per chunk, for gaps the growth from the first cannot reach
+    constexpr int SEEDS = 4;
+    constexpr float TWO_PI = 6.28318531f;
+    // candidate directions come from a table instead of calling sin/cos
+    constexpr int DIRECTION_BITS = 8;
+    constexpr int DIRECTIONS     = 1 << DIRECTION_BITS;
+    constexpr int DIRECTION_STEP = DIRECTIONS / ATTEMPTS;
+    // far enough from anything to never conflict, small enough to square
+    constexpr float EMPTY = -1e18f;
+    // the meshes fit in a unit tall column of this radius
+    constexpr float MESH_RADIUS = 0.5f;
+    constexpr float MESH_HEIGHT = 1.f;
+    // push, translate, rotate, scale, call and pop as opcodes and arguments
+    constexpr size_t LIST_BYTES_PER_INSTANCE = 68;
+
+    // one generator per chunk, so the result is the same on any thread count
+    struct Random {
+        uint64_t state;
+
+        explicit Random(uint64_t seed) : state(seed) {}
+        uint32_t next() {
+            state += 0x9e3779b97f4a7c15ull;
+            auto z = state;
+            z      = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z      = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+        }
+        float uniform() {
+            return (next() >> 8) * (1.f / 16777216.f);
+        }
+    };
+
+    struct Point {
+        float x, z;
+    };
+
+    /**
+     * Background grid with cells small enough to hold one sample each, so a
+     * candidate only has to be compared with the 5x5 cells around it, less
+     * the corners, which are always a radius away. Two cells of padding on
+     * every side keep the lookups free of bounds checks.
+     */
+    struct SampleGrid {
+        float inverse;
+        int width;
+        Point *cells;
+
+        SampleGrid(float cellSize, float extentX, float extentZ,
+                   SDLEngine::ScratchArena &scratch)
+            : inverse(1.f / cellSize),
+              width(static_cast<int>(extentX * inverse) + 5) {
+            auto count = static_cast<size_t>(width) *
+                         (static_cast<int>(extentZ * inverse) + 5);
+            cells = scratch.allocate<Point>(count);
+            std::fill(cells, cells + count, Point{EMPTY, EMPTY});
+        }
+
+        // most samples a width by depth area can hold, one per cell it touches
+        size_t capacity(float extentX, float extentZ) const {
+            return static_cast<size_t>(static_cast<int>(extentX * inverse) + 2) *
+                   (static_cast<int>(extentZ * inverse) + 2);
+        }
+
+        size_t cell(const Point &p) const {
+            return static_cast<size_t>(static_cast<int>(p.z * inverse) + 2) *
+                       width +
+                   static_cast<int>(p.x * inverse) + 2;
+        }
+
+        bool isFree(const Point &p, float radiusSquared) const {
+            auto centre = cell(p);
+            for (int dz = -2; dz <= 2; dz++) {
+                auto row   = cells + centre + dz * width;
+                auto reach = dz == -2 || dz == 2 ? 1 : 2;
+                for (int dx = -reach; dx <= reach; dx++) {
+                    auto x = row[dx].x - p.x;
+                    auto z = row[dx].z - p.z;
+                    if (x * x + z * z < radiusSquared) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void insert(const Point &p) {
+            cells[cell(p)] = p;
+        }
+    };
+
+    float sampleHeight(const float *heights, int size, float fx, float fz) {
+        fx      = std::clamp(fx, 0.f, size - 1.f);
+        fz      = std::clamp(fz, 0.f, size - 1.f);
+        auto x0 = std::min(static_cast<int>(fx), size - 2);
+        auto z0 = std::min(static_cast<int>(fz), size - 2);
+        auto tx = fx - x0;
+        auto tz = fz - z0;
+        auto row0   = heights + static_cast<size_t>(z0) * size;
+        auto row1   = row0 + size;
+        auto top    = row0[x0] + (row0[x0 + 1] - row0[x0]) * tx;
+        auto bottom = row1[x0] + (row1[x0 + 1] - row1[x0]) * tx;
+        return top + (bottom - top) * tz;
+    }
+
+    void face(const float *a, const float *b, const float *c) {
+        float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        glNormal3f(u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2],
+                   u[0] * v[1] - u[1] * v[0]);
+        glVertex3fv(a);
+        glVertex3fv(b);
+        glVertex3fv(c);
+    }
+}
+
+size_t Scatter::Instances::size() const {
+    return x.size();
+}
+
+void Scatter::Instances::resize(size_t count) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    scale.resize(count);
+    rotation.resize(count);
+}
+
+Scatter::Scatter(const Parameters &parameters) : params(parameters) {}
+
+Scatter::Scatter(Scatter &&other) noexcept {
+    take(other);
+}
+
+Scatter::~Scatter() = default;
+
+Scatter &Scatter::operator=(Scatter &&other) noexcept {
+    if (this != &other) {
+        deleteLists();
+        take(other);
+    }
+    return *this;
+}
+
+void Scatter::take(Scatter &other) {
+    params     = other.params;
+    data       = std::move(other.data);
+    chunks     = std::move(other.chunks);
+    scratch    = std::move(other.scratch);
+    meshList   = std::exchange(other.meshList, 0);
+    chunkLists = std::exchange(other.chunkLists, 0);
+    listCount  = std::exchange(other.listCount, 0);
+    listBytes  = std::exchange(other.listBytes, 0);
+    listsDirty = std::exchange(other.listsDirty, true);
+    visible    = std::exchange(other.visible, 0);
+}
+
+void Scatter::generate(const float *heights, int size, float scaleX,
+                       float scaleY, float scaleZ) {
+    clear();
+    // the slope of a sample reads its neighbours, which needs an interior
+    if (size < 3 || params.radius <= 0.f) {
+        return;
+    }
+
+    // chunks of at least three radii keep chunks of the same phase from
+    // reading the grid cells the others are writing
+    auto extentX      = (size - 1) * scaleX;
+    auto extentZ      = (size - 1) * scaleZ;
+    auto chunkSamples = std::max(
+        MIN_CHUNK_SAMPLES,
+        static_cast<int>(std::ceil(3.f * params.radius /
+                                   std::min(scaleX, scaleZ))));
+    auto chunkX       = chunkSamples * scaleX;
+    auto chunkZ       = chunkSamples * scaleZ;
+    auto chunksX      = static_cast<int>(std::ceil(extentX / chunkX));
+    auto chunksZ      = static_cast<int>(std::ceil(extentZ / chunkZ));
+
+    auto count  = static_cast<size_t>(size) * size;
+    auto range  = std::minmax_element(heights, heights + count);
+    auto low    = *range.first;
+    auto extent = std::max(*range.second - low, 1e-6f);
+
+    // each chunk gets room for as many samples as it has cells, taken from
+    // the arena up front since the chunks are sampled in parallel
+    scratch.reset();
+    auto radiusSquared = params.radius * params.radius;
+    auto grid = SampleGrid(params.radius / std::sqrt(2.f), extentX, extentZ,
+                           scratch);
+    auto chunkCount  = static_cast<size_t>(chunksX) * chunksZ;
+    auto perChunk    = grid.capacity(chunkX, chunkZ);
+    auto slots       = chunkCount * perChunk;
+    auto samples     = scratch.allocate<Point>(slots);
+    auto active      = scratch.allocate<size_t>(slots);
+    auto placedX     = scratch.allocate<float>(slots);
+    auto placedY     = scratch.allocate<float>(slots);
+    auto placedZ     = scratch.allocate<float>(slots);
+    auto placedScale = scratch.allocate<float>(slots);
+    auto placedAngle = scratch.allocate<float>(slots);
+    auto placedCount = scratch.allocate<size_t>(chunkCount);
+
+    float directionX[DIRECTIONS];
+    float directionZ[DIRECTIONS];
+    for (int i = 0; i < DIRECTIONS; i++) {
+        directionX[i] = std::cos(i * TWO_PI / DIRECTIONS);
+        directionZ[i] = std::sin(i * TWO_PI / DIRECTIONS);
+    }
+    auto spacing = params.radius * 1.0001f;
+
+    auto sampleChunk = [&](int cx, int cz) {
+        auto minX = cx * chunkX;
+        auto minZ = cz * chunkZ;
+        auto maxX = std::min(minX + chunkX, extentX);
+        auto maxZ = std::min(minZ + chunkZ, extentZ);
+        auto chunkKey = static_cast<uint64_t>(cz) << 32 | static_cast<uint32_t>(cx);
+        auto random   = Random(params.seed * 0x2545f4914f6cdd1dull ^ chunkKey);
+        auto index    = static_cast<size_t>(cz) * chunksX + cx;
+        auto first    = index * perChunk;
+
+        auto chunkSamples = samples + first;
+        auto chunkActive  = active + first;
+        size_t sampleCount = 0;
+        size_t activeCount = 0;
+        auto tryInsert = [&](const Point &p) {
+            if (p.x < minX || p.x >= maxX || p.z < minZ || p.z >= maxZ ||
+                !grid.isFree(p, radiusSquared)) {
+                return false;
+            }
+            grid.insert(p);
+            chunkActive[activeCount++]  = sampleCount;
+            chunkSamples[sampleCount++] = p;
+            return true;
+        };
+
+        for (int seed = 0; seed < SEEDS; seed++) {
+            tryInsert({minX + random.uniform() * (maxX - minX),
+                       minZ + random.uniform() * (maxZ - minZ)});
+            while (activeCount > 0) {
+                auto slot   = random.next() % activeCount;
+                auto origin = chunkSamples[chunkActive[slot]];
+                auto grown  = false;
+                // evenly spaced directions from a random start, just outside
+                // the radius, pack far more samples per attempt than random
+                // points in the annulus out to twice the radius
+                auto start = random.next() >> (32 - DIRECTION_BITS);
+                for (int attempt = 0; attempt < ATTEMPTS && !grown; attempt++) {
+                    auto direction = (start + attempt * DIRECTION_STEP) &
+                                     (DIRECTIONS - 1);
+                    grown = tryInsert(
+                        {origin.x + directionX[direction] * spacing,
+                         origin.z + directionZ[direction] * spacing});
+                }
+                if (!grown) {
+                    chunkActive[slot] = chunkActive[--activeCount];
+                }
+            }
+        }
+
+        // thin the samples by the placement rules
+        auto &kept = placedCount[index];
+        kept       = 0;
+        for (size_t i = 0; i < sampleCount; i++) {
+            const auto &p = chunkSamples[i];
+            auto fx     = p.x / scaleX;
+            auto fz     = p.z / scaleZ;
+            auto height = sampleHeight(heights, size, fx, fz);
+            auto x0     = std::clamp(static_cast<int>(fx + 0.5f), 1, size - 2);
+            auto z0     = std::clamp(static_cast<int>(fz + 0.5f), 1, size - 2);
+            auto row    = heights + static_cast<size_t>(z0) * size;
+            auto gx     = (row[x0 + 1] - row[x0 - 1]) * scaleY / (2.f * scaleX);
+            auto gz     = (row[x0 + size] - row[x0 - size]) * scaleY /
+                      (2.f * scaleZ);
+            auto slope    = std::sqrt(gx * gx + gz * gz);
+            auto relative = (height - low) / extent;
+            if (relative < params.minHeight || relative > params.maxHeight ||
+                slope < params.minSlope || slope > params.maxSlope ||
+                random.uniform() >= params.density) {
+                continue;
+            }
+            auto out         = first + kept++;
+            placedX[out]     = p.x;
+            placedY[out]     = height * scaleY;
+            placedZ[out]     = p.z;
+            placedScale[out] = params.minScale +
+                               random.uniform() *
+                                   (params.maxScale - params.minScale);
+            placedAngle[out] = random.uniform() * 360.f;
+        }
+    };
+
+    // chunks sharing a corner of the 2x2 pattern never touch each other
+    auto phase = scratch.allocate<std::pair<int, int>>(
+        static_cast<size_t>((chunksX + 1) / 2) * ((chunksZ + 1) / 2));
+    for (int pz = 0; pz < 2; pz++) {
+        for (int px = 0; px < 2; px++) {
+            size_t phaseSize = 0;
+            for (int cz = pz; cz < chunksZ; cz += 2) {
+                for (int cx = px; cx < chunksX; cx += 2) {
+                    phase[phaseSize++] = {cx, cz};
+                }
+            }
+            SDLEngine::parallelFor(phaseSize, 1,
+                                   [&](size_t begin, size_t end) {
+                                       for (auto i = begin; i < end; i++) {
+                                           sampleChunk(phase[i].first,
+                                                       phase[i].second);
+                                       }
+                                   });
+        }
+    }
+
+    // pack every chunk's instances into one set of arrays, in chunk order
+    chunks.resize(chunkCount);
+    size_t total = 0;
+    for (size_t i = 0; i < chunkCount; i++) {
+        chunks[i].first = total;
+        chunks[i].count = placedCount[i];
+        total += chunks[i].count;
+    }
+    data.resize(total);
+    SDLEngine::parallelFor(chunkCount, 8, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto &chunk  = chunks[i];
+            auto first   = chunk.first;
+            auto source  = i * perChunk;
+            auto last    = source + chunk.count;
+            std::copy(placedX + source, placedX + last, data.x.begin() + first);
+            std::copy(placedY + source, placedY + last, data.y.begin() + first);
+            std::copy(placedZ + source, placedZ + last, data.z.begin() + first);
+            std::copy(placedScale + source, placedScale + last,
+                      data.scale.begin() + first);
+            std::copy(placedAngle + source, placedAngle + last,
+                      data.rotation.begin() + first);
+
+            std::fill(chunk.min, chunk.min + 3,
+                      std::numeric_limits<float>::max());
+            std::fill(chunk.max, chunk.max + 3,
+                      std::numeric_limits<float>::lowest());
+            for (size_t j = first; j < first + chunk.count; j++) {
+                auto reach    = data.scale[j] * MESH_RADIUS;
+                float low[3]  = {data.x[j] - reach, data.y[j],
+                                 data.z[j] - reach};
+                float high[3] = {data.x[j] + reach,
+                                 data.y[j] + data.scale[j] * MESH_HEIGHT,
+                                 data.z[j] + reach};
+                for (int axis = 0; axis < 3; axis++) {
+                    chunk.min[axis] = std::min(chunk.min[axis], low[axis]);
+                    chunk.max[axis] = std::max(chunk.max[axis], high[axis]);
+                }
+            }
+        }
+    });
+    listsDirty = true;
+}
+
+void Scatter::clear() {
+    data.resize(0);
+    chunks.clear();
+    listsDirty = true;
+    visible    = 0;
+}
+
+void Scatter::render() {
+    visible = 0;
+    if (listsDirty) {
+        compileLists();
+    }
+    if (chunks.empty()) {
+        return;
+    }
+
+    // clip space planes from the combined projection and modelview matrix
+    GLfloat projection[16];
+    GLfloat modelview[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    float clip[16];
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            clip[column * 4 + row] = 0.f;
+            for (int k = 0; k < 4; k++) {
+                clip[column * 4 + row] +=
+                    projection[k * 4 + row] * modelview[column * 4 + k];
+            }
+        }
+    }
+    float planes[6][4];
+    for (int plane = 0; plane < 6; plane++) {
+        auto row  = plane / 2;
+        auto sign = plane % 2 == 0 ? 1.f : -1.f;
+        for (int i = 0; i < 4; i++) {
+            planes[plane][i] = clip[i * 4 + 3] + sign * clip[i * 4 + row];
+        }
+    }
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_NORMALIZE);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const auto &chunk = chunks[i];
+        if (chunk.count == 0) {
+            continue;
+        }
+        auto inside = true;
+        for (int plane = 0; plane < 6 && inside; plane++) {
+            const auto *p = planes[plane];
+            auto x = p[0] > 0.f ? chunk.max[0] : chunk.min[0];
+            auto y = p[1] > 0.f ? chunk.max[1] : chunk.min[1];
+            auto z = p[2] > 0.f ? chunk.max[2] : chunk.min[2];
+            inside = p[0] * x + p[1] * y + p[2] * z + p[3] >= 0.f;
+        }
+        if (inside) {
+            glCallList(chunkLists + static_cast<GLuint>(i));
+            visible++;
+        }
+    }
+    glPopAttrib();
+}
+
+void Scatter::shutdown() {
+    deleteLists();
+    listsDirty = true;
+}
+
+void Scatter::compileLists() {
+    listsDirty = false;
+    if (meshList == 0) {
+        meshList = glGenLists(1);
+        glNewList(meshList, GL_COMPILE);
+        compileMesh();
+        glEndList();
+    }
+    deleteChunkLists();
+    if (chunks.empty()) {
+        return;
+    }
+
+    // fixed-function GL has no instanced draw, so each chunk's transforms
+    // are recorded once and replayed with a single call
+    listCount  = static_cast<GLsizei>(chunks.size());
+    chunkLists = glGenLists(listCount);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        glNewList(chunkLists + static_cast<GLuint>(i), GL_COMPILE);
+        auto first = chunks[i].first;
+        for (auto j = first; j < first + chunks[i].count; j++) {
+            glPushMatrix();
+            glTranslatef(data.x[j], data.y[j], data.z[j]);
+            glRotatef(data.rotation[j], 0.f, 1.f, 0.f);
+            glScalef(data.scale[j], data.scale[j], data.scale[j]);
+            glCallList(meshList);
+            glPopMatrix();
+        }
+        glEndList();
+    }
+
+    // GL cannot report what a display list costs, so account the commands
+    // recorded per instance
+    listBytes = data.size() * LIST_BYTES_PER_INSTANCE;
+    SDLEngine::MemoryTracker::allocated(SDLEngine::MemoryTag::GpuBuffers,
+                                        listBytes);
+}
+
+void Scatter::deleteChunkLists() {
+    if (chunkLists == 0) {
+        return;
+    }
+    glDeleteLists(chunkLists, listCount);
+    SDLEngine::MemoryTracker::freed(SDLEngine::MemoryTag::GpuBuffers,
+                                    listBytes);
+    chunkLists = 0;
+    listCount  = 0;
+    listBytes  = 0;
+}
+
+void Scatter::deleteLists() {
+    deleteChunkLists();
+    if (meshList != 0) {
+        glDeleteLists(meshList, 1);
+        meshList = 0;
+    }
+}
+
+void Scatter::compileMesh() const {
+    glBegin(GL_TRIANGLES);
+    if (params.shape == Shape::Tree) {
+        // a short square trunk under an eight sided cone
+        const float trunk = 0.08f;
+        float base[4][3]  = {{-trunk, 0.f, -trunk}, {trunk, 0.f, -trunk},
+                             {trunk, 0.f, trunk},   {-trunk, 0.f, trunk}};
+        glColor3f(0.40f, 0.27f, 0.15f);
+        for (int i = 0; i < 4; i++) {
+            auto a = base[i];
+            auto b = base[(i + 1) % 4];
+            float top[2][3] = {{a[0], 0.3f, a[2]}, {b[0], 0.3f, b[2]}};
+            face(a, top[0], b);
+            face(b, top[0], top[1]);
+        }
+
+        glColor3f(0.16f, 0.40f, 0.18f);
+        float apex[3] = {0.f, MESH_HEIGHT, 0.f};
+        for (int i = 0; i < 8; i++) {
+            auto a0  = i * TWO_PI / 8;
+            auto a1  = (i + 1) * TWO_PI / 8;
+            float a[3] = {std::cos(a0) * MESH_RADIUS * 0.8f, 0.25f,
+                          std::sin(a0) * MESH_RADIUS * 0.8f};
+            float b[3] = {std::cos(a1) * MESH_RADIUS * 0.8f, 0.25f,
+                          std::sin(a1) * MESH_RADIUS * 0.8f};
+            float centre[3] = {0.f, 0.25f, 0.f};
+            face(a, apex, b);
+            face(a, b, centre);
+        }
+    } else {
+        // a squashed octahedron
+        glColor3f(0.48f, 0.46f, 0.44f);
+        float top[3]    = {0.f, MESH_HEIGHT * 0.6f, 0.f};
+        float bottom[3] = {0.f, -0.1f, 0.f};
+        float ring[4][3] = {{MESH_RADIUS, 0.2f, 0.f},
+                            {0.f, 0.2f, MESH_RADIUS * 0.8f},
+                            {-MESH_RADIUS * 0.9f, 0.2f, 0.f},
+                            {0.f, 0.2f, -MESH_RADIUS}};
+        for (int i = 0; i < 4; i++) {
+            auto a = ring[i];
+            auto b = ring[(i + 1) % 4];
+            face(a, top, b);
+            face(a, b, bottom);
+        }
+    }
+    glEnd();
+}
+
+const Scatter::Instances &Scatter::instances() const {
+    return data;
+}
+
+size_t Scatter::chunkCount() const {
+    return chunks.size();
+}
+
+size_t Scatter::visibleChunks() const {
+    return visible;
+}
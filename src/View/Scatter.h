@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Engine/MemoryTracker.hpp"
+#include "Engine/OpenGL.hpp"
+#include "Engine/ScratchArena.hpp"
+
+/**
+ * @brief Scatters objects such as trees and rocks over a heightfield with
+ * Poisson-disk sampling, so no two instances are closer than the radius.
+ *
+ * The terrain is split into square chunks at least three radii wide and
+ * sampled in four phases, one per corner of a 2x2 chunk pattern. Chunks of
+ * the same phase are far enough apart that their samples can never meet, so
+ * each phase runs its chunks in parallel while still seeing every sample an
+ * earlier phase placed along its borders. Samples are then thinned by the
+ * height and slope rules.
+ *
+ * Instances are kept as one array per attribute, grouped by chunk, and each
+ * chunk is compiled into a display list that is drawn only when its bounds
+ * are inside the view frustum.
+ */
+class Scatter {
+
+  public:
+    enum class Shape { Tree, Rock };
+
+    struct Parameters {
+        Shape shape = Shape::Tree;
+        // smallest distance between two instances, in world units
+        float radius = 6.f;
+        // fractions of the height range and rise over run where instances
+        // may appear, and the fraction of candidate spots that get one
+        float minHeight = 0.f;
+        float maxHeight = 1.f;
+        float minSlope  = 0.f;
+        float maxSlope  = 1.f;
+        float density   = 1.f;
+        float minScale  = 2.f;
+        float maxScale  = 4.f;
+        uint32_t seed   = 1;
+    };
+
+    struct Instances {
+        using Attribute =
+            SDLEngine::TrackedVector<float, SDLEngine::MemoryTag::Mesh>;
+
+        Attribute x;
+        Attribute y;
+        Attribute z;
+        Attribute scale;
+        // degrees about the y axis
+        Attribute rotation;
+
+        size_t size() const;
+        void resize(size_t count);
+    };
+
+    Scatter() = default;
+    explicit Scatter(const Parameters &parameters);
+    // owns its display lists, so it can be moved but not copied
+    Scatter(Scatter &&other) noexcept;
+    Scatter(const Scatter &) = delete;
+    ~Scatter();
+
+    Scatter &operator=(Scatter &&other) noexcept;
+    Scatter &operator=(const Scatter &) = delete;
+
+    void generate(const float *heights, int size, float scaleX, float scaleY,
+                  float scaleZ);
+    void clear();
+    // draws the chunks inside the current projection and modelview frustum
+    void render();
+    // deletes the display lists while the context still exists, render()
+    // compiles them again if needed; the destructor makes no GL calls
+    void shutdown();
+
+    const Instances &instances() const;
+    size_t chunkCount() const;
+    size_t visibleChunks() const;
+
+  private:
+    struct Chunk {
+        size_t first = 0;
+        size_t count = 0;
+        float min[3];
+        float max[3];
+    };
+
+    void compileLists();
+    void compileMesh() const;
+    void deleteChunkLists();
+    void deleteLists();
+    // takes other's data and GL handles, leaving it with none
+    void take(Scatter &other);
+
+    Parameters params;
+    Instances data;
+    std::vector<Chunk> chunks;
+    // sample grid and per chunk buffers, reused by every generate
+    SDLEngine::ScratchArena scratch;
+    GLuint meshList   = 0;
+    GLuint chunkLists = 0;
+    GLsizei listCount = 0;
+    // estimated driver memory held by the chunk lists
+    size_t listBytes  = 0;
+    bool listsDirty   = false;
+    size_t visible    = 0;
+};
@@ -0,0 +1,114 @@
+#include "SplatMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Engine/ParallelFor.hpp"
+#include "Engine/Utility.hpp"
+
+using SDLEngine::toByte;
+
+namespace {
+    constexpr int ROWS_PER_TASK = 16;
+
+    float smoothstep(float edge0, float edge1, float value) {
+        auto t = std::clamp((value - edge0) / (edge1 - edge0), 0.f, 1.f);
+        return t * t * (3.f - 2.f * t);
+    }
+}
+
+void SplatMap::build(const float *heights, int size,
+                     const Parameters &parameters) {
+    clear();
+    if (size < 2) {
+        return;
+    }
+    mapSize    = size;
+    auto count = static_cast<size_t>(size) * size;
+    weights.resize(count * LAYERS);
+    colours.resize(count * 3);
+
+    auto range  = std::minmax_element(heights, heights + count);
+    auto low    = *range.first;
+    auto extent = std::max(*range.second - low, 1e-6f);
+    const auto &p = parameters;
+
+    SDLEngine::parallelFor(size, ROWS_PER_TASK, [&](size_t begin, size_t end) {
+        for (auto z = static_cast<int>(begin); z < static_cast<int>(end); z++) {
+            auto zUp   = std::max(z - 1, 0);
+            auto zDown = std::min(z + 1, size - 1);
+            auto row   = heights + static_cast<size_t>(z) * size;
+            auto up    = heights + static_cast<size_t>(zUp) * size;
+            auto down  = heights + static_cast<size_t>(zDown) * size;
+            auto spanZ = (zDown - zUp) * p.scaleZ;
+
+            for (int x = 0; x < size; x++) {
+                auto xLeft  = std::max(x - 1, 0);
+                auto xRight = std::min(x + 1, size - 1);
+                auto gx     = (row[xRight] - row[xLeft]) * p.scaleY /
+                          ((xRight - xLeft) * p.scaleX);
+                auto gz     = (down[x] - up[x]) * p.scaleY / spanZ;
+                auto slope  = std::sqrt(gx * gx + gz * gz);
+                auto height = (row[x] - low) / extent;
+
+                // rock takes the steep ground, snow and sand split what is
+                // left by height and grass has the remainder
+                float layer[LAYERS];
+                layer[Rock] = smoothstep(p.rockSlope - p.slopeBlend,
+                                         p.rockSlope + p.slopeBlend, slope);
+                auto flat   = 1.f - layer[Rock];
+                layer[Snow] = flat * smoothstep(p.snowLine - p.heightBlend,
+                                                p.snowLine + p.heightBlend,
+                                                height);
+                layer[Sand] = (flat - layer[Snow]) *
+                              (1.f - smoothstep(p.sandLine - p.heightBlend,
+                                                p.sandLine + p.heightBlend,
+                                                height));
+                layer[Grass] = flat - layer[Snow] - layer[Sand];
+
+                auto index = static_cast<size_t>(z) * size + x;
+                float blended[3] = {0.f, 0.f, 0.f};
+                for (int l = 0; l < LAYERS; l++) {
+                    weights[index * LAYERS + l] = toByte(layer[l]);
+                    for (int c = 0; c < 3; c++) {
+                        blended[c] += layer[l] * p.colours[l][c];
+                    }
+                }
+                for (int c = 0; c < 3; c++) {
+                    colours[index * 3 + c] = toByte(blended[c]);
+                }
+            }
+        }
+    });
+}
+
+void SplatMap::clear() {
+    mapSize = 0;
+    weights.clear();
+    colours.clear();
+}
+
+int SplatMap::size() const {
+    return mapSize;
+}
+
+bool SplatMap::empty() const {
+    return mapSize == 0;
+}
+
+size_t SplatMap::texel(int x, int z) const {
+    x = std::clamp(x, 0, mapSize - 1);
+    z = std::clamp(z, 0, mapSize - 1);
+    return static_cast<size_t>(z) * mapSize + x;
+}
+
+float SplatMap::weight(int x, int z, Layer layer) const {
+    return weights[texel(x, z) * LAYERS + layer] / 255.f;
+}
+
+void SplatMap::colour(int x, int z, float &r, float &g, float &b) const {
+    auto index = texel(x, z) * 3;
+    r          = colours[index] / 255.f;
+    g          = colours[index + 1] / 255.f;
+    b          = colours[index + 2] / 255.f;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Engine/MemoryTracker.hpp"
+
+/**
+ * @brief Material weights for the terrain, derived from height and slope in a
+ * single parallel pass. Each texel holds the weight of every layer and the
+ * layer colours already blended by those weights, so drawing the blend is a
+ * single lookup per vertex however many layers there are.
+ */
+class SplatMap {
+
+  public:
+    enum Layer { Sand, Grass, Rock, Snow, LAYERS };
+
+    struct Parameters {
+        float scaleX = 1.f;
+        float scaleY = 1.f;
+        float scaleZ = 1.f;
+        // fractions of the height range where sand ends and snow begins
+        float sandLine    = 0.15f;
+        float snowLine    = 0.75f;
+        float heightBlend = 0.05f;
+        // rise over run where grass gives way to rock
+        float rockSlope  = 0.8f;
+        float slopeBlend = 0.25f;
+        float colours[LAYERS][3] = {{0.76f, 0.70f, 0.50f},
+                                    {0.36f, 0.55f, 0.24f},
+                                    {0.46f, 0.42f, 0.39f},
+                                    {0.95f, 0.95f, 0.97f}};
+    };
+
+    void build(const float *heights, int size, const Parameters &parameters);
+    void clear();
+
+    int size() const;
+    bool empty() const;
+
+    // indices are clamped to the map
+    float weight(int x, int z, Layer layer) const;
+    void colour(int x, int z, float &r, float &g, float &b) const;
+
+  private:
+    size_t texel(int x, int z) const;
+
+    int mapSize = 0;
+    // LAYERS weights then three colour bytes per texel
+    SDLEngine::TrackedVector<uint8_t, SDLEngine::MemoryTag::Textures> weights;
+    SDLEngine::TrackedVector<uint8_t, SDLEngine::MemoryTag::Textures> colours;
+};
@@ -1,7 +1,7 @@
 #include "Terrain.h"
 
-#include <SDL_image.h>
 #include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <time.h>
@@ -10,6 +10,22 @@
 
 #include "Engine/Engine.hpp"
 #include "Engine/OpenGL.hpp"
+#include "MeshExport.h"
+#include "TerrainKernels.h"
+
+namespace {
+    // the original nested vectors were drawn as terrainData[x][z], so the
+    // first index of a row-major grid runs along x; swapping it keeps loaded
+    // and generated terrain facing the same way as before
+    void transpose(float *heights, int size) {
+        for (int z = 0; z < size; z++) {
+            for (int x = z + 1; x < size; x++) {
+                std::swap(heights[static_cast<size_t>(z) * size + x],
+                          heights[static_cast<size_t>(x) * size + z]);
+            }
+        }
+    }
+}
 
 Terrain::Terrain() {
     scaleX    = 1.0f;
@@ -18,59 +34,228 @@ Terrain::Terrain() {
     TextureID = 0;
 }
 
+void Terrain::loadTexture() {
+    // decoded and mipmapped on a worker, render() uploads it once ready
+    if (terrainTexture < 0) {
+        terrainTexture = textures.request("terrain.png");
+    }
+}
+
+void Terrain::setMaxMeshError(float maxError) {
+    maxMeshError = maxError;
+}
+
+void Terrain::setBakedLighting(bool enabled) {
+    bakedLighting = enabled;
+    // without baked lighting the lightmap only holds normals, either way the
+    // next build bakes what the new setting needs
+    lightmap.clear();
+}
+
+void Terrain::setSplatting(bool enabled) {
+    splatting = enabled;
+    if (!enabled) {
+        splat.clear();
+    }
+}
+
+void Terrain::addScatter(const Scatter::Parameters &parameters) {
+    scatters.emplace_back(parameters);
+}
+
+void Terrain::clearScatters() {
+    // a scatter's destructor leaves its display lists to shutdown()
+    for (auto &scatter : scatters) {
+        scatter.shutdown();
+    }
+    scatters.clear();
+}
+
+size_t Terrain::scatterInstances() const {
+    size_t count = 0;
+    for (const auto &scatter : scatters) {
+        count += scatter.instances().size();
+    }
+    return count;
+}
+
 void Terrain::createTriangles() {
+    loadTexture();
+    updateSurfaceMaps();
+    if (maxMeshError > 0.f) {
+        createSimplifiedTriangles();
+        return;
+    }
+
+    // clear keeps the capacity, so rebuilding at the same size reuses it
+    terrainVertices.clear();
+    terrainIndices.clear();
+    auto size = terrainData.size();
+    if (size < 2) {
+        return;
+    }
+    auto width = static_cast<uint32_t>(size);
+    terrainVertices.reserve(static_cast<size_t>(size) * size);
+    terrainIndices.reserve(6 * static_cast<size_t>(size - 1) * (size - 1));
+
+    // one vertex per sample, dequantized a row at a time
+    auto stepX = spacingX();
+    auto stepZ = spacingZ();
+    scratch.reset();
+    auto row = scratch.allocate<float>(size);
+    for (int z = 0; z < size; z++) {
+        terrainData.readRow(z, 0, size, row);
+        for (int x = 0; x < size; x++) {
+            terrainVertices.emplace_back(x * stepX, row[x] * scaleY, z * stepZ);
+        }
+    }
 
-    SDL_Surface *Surface = IMG_Load("terrain.png");
-    glGenTextures(1, &TextureID);
-    glBindTexture(GL_TEXTURE_2D, TextureID);
-
-    int Mode = GL_RGB;
-    if (Surface->format->BitsPerPixel == 4) {
-        Mode = GL_RGBA;
-    }
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-    glTexImage2D(GL_TEXTURE_2D, 0, Mode, Surface->w, Surface->h, 0, Mode,
-                 GL_UNSIGNED_BYTE, Surface->pixels);
-
-    for (size_t z = 0; z < terrainData.size() - 1; z++) {
-        for (size_t x = 0; x < terrainData.size() - 1; x++) {
-
-            triangle left;
-            triangle right;
-
-            left.first =
-                glm::vec3((x * scaleX), terrainData[x][z] * scaleY, (z)*scaleZ);
-            left.second =
-                glm::vec3((x + 1) * scaleX,
-                          terrainData.at(x + 1).at(z) * scaleY, (z)*scaleZ);
-            left.third = glm::vec3((x + 1) * scaleX,
-                                   terrainData.at(x + 1).at(z + 1) * scaleY,
-                                   (z + 1) * scaleZ);
-
-            right.first = glm::vec3((x)*scaleX, terrainData.at(x).at(z) * scaleY,
-                                    (z)*scaleZ);
-            right.second = glm::vec3((x + 1) * scaleX,
-                                     terrainData.at(x + 1).at(z + 1) * scaleY,
-                                     (z + 1) * scaleZ);
-            right.third = glm::vec3((x)*scaleX, terrainData.at(x).at(z + 1) * scaleY,
-                                    (z + 1) * scaleZ);
-
-            terrainTri.push_back(left);
-            terrainTri.push_back(right);
+    // the same two triangles per quad as the original unshared mesh, wound
+    // counter-clockwise seen from +y so their normals point up
+    for (uint32_t z = 0; z + 1 < width; z++) {
+        for (uint32_t x = 0; x + 1 < width; x++) {
+            auto a = z * width + x;
+            auto d = a + width;
+            terrainIndices.insert(terrainIndices.end(),
+                                  {a, d + 1, a + 1, a, d, d + 1});
         }
     }
 }
 
+void Terrain::updateSurfaceMaps() {
+    auto size = terrainData.size();
+    if (size < 2) {
+        lightmap.clear();
+        splat.clear();
+        for (auto &scatter : scatters) {
+            scatter.clear();
+        }
+        return;
+    }
+
+    // every map works from the same dequantized copy of the heightfield
+    scratch.reset();
+    auto heights = scratch.allocate<float>(static_cast<size_t>(size) * size);
+    for (int z = 0; z < size; z++) {
+        terrainData.readRow(z, 0, size, heights + static_cast<size_t>(z) * size);
+    }
+    bakeLighting(heights, size);
+    if (splatting) {
+        SplatMap::Parameters parameters;
+        parameters.scaleX = spacingX();
+        parameters.scaleY = scaleY;
+        parameters.scaleZ = spacingZ();
+        splat.build(heights, size, parameters);
+    }
+    for (auto &scatter : scatters) {
+        scatter.generate(heights, size, spacingX(), scaleY, spacingZ());
+    }
+}
+
+void Terrain::bakeLighting(const float *heights, int size) {
+    Lightmap::Parameters parameters;
+    parameters.scaleX = spacingX();
+    parameters.scaleY = scaleY;
+    parameters.scaleZ = spacingZ();
+    if (!bakedLighting) {
+        // GL still lights the mesh, render() takes its normals from the map
+        lightmap.bakeNormals(heights, size, parameters);
+        return;
+    }
+
+    auto key = Lightmap::key(heights, size, parameters);
+    if (!lightmap.empty() && lightmap.bakedKey() == key) {
+        return;
+    }
+    auto cacheFile = heightfieldFile.empty() ? "" : heightfieldFile + ".light";
+    if (!cacheFile.empty() && lightmap.load(cacheFile, key)) {
+        return;
+    }
+    lightmap.bake(heights, size, parameters);
+    if (!cacheFile.empty()) {
+        lightmap.save(cacheFile);
+    }
+}
+
+void Terrain::createSimplifiedTriangles() {
+    simplifier.build(terrainData);
+    simplifier.extract(maxMeshError, simplified);
+
+    terrainVertices.clear();
+    terrainIndices.clear();
+    terrainIndices.reserve(simplified.size() * 3);
+
+    // a sample gets its vertex the first time a triangle uses it
+    constexpr auto UNUSED = ~uint32_t{0};
+    auto size             = terrainData.size();
+    scratch.reset();
+    auto count  = static_cast<size_t>(size) * size;
+    auto remap  = scratch.allocate<uint32_t>(count);
+    std::fill(remap, remap + count, UNUSED);
+    auto stepX  = spacingX();
+    auto stepZ  = spacingZ();
+    auto vertex = [&](int x, int z) {
+        auto &index = remap[static_cast<size_t>(z) * size + x];
+        if (index == UNUSED) {
+            index = static_cast<uint32_t>(terrainVertices.size());
+            terrainVertices.emplace_back(
+                x * stepX, terrainData.get(x, z) * scaleY, z * stepZ);
+        }
+        return index;
+    };
+    for (const auto &tri : simplified) {
+        terrainIndices.insert(terrainIndices.end(),
+                              {vertex(tri.ax, tri.az), vertex(tri.bx, tri.bz),
+                               vertex(tri.cx, tri.cz)});
+    }
+}
+
 void Terrain::render(bool wireframe) {
 
     int count = 0;
 
-    for (auto tri : terrainTri) {
+    textures.upload();
+    TextureID = textures.textureID(terrainTexture);
+
+    // vertices sit on heightfield samples, so the baked light, the baked
+    // normal and the blended material colour are one lookup each per vertex,
+    // and with baked light the fixed-function lighting can be switched off
+    auto baked    = bakedLighting && lightmap.size() == terrainData.size();
+    auto normals  = !bakedLighting && lightmap.size() == terrainData.size();
+    auto splatted = splatting && splat.size() == terrainData.size();
+    if (baked || splatted) {
+        glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    }
+    if (baked) {
+        glDisable(GL_LIGHTING);
+    }
+    auto stepX  = spacingX();
+    auto stepZ  = spacingZ();
+    auto vertex = [&](const glm::vec3 &v) {
+        if (baked || normals || splatted) {
+            auto x = static_cast<int>(std::lround(v.x / stepX));
+            auto z = static_cast<int>(std::lround(v.z / stepZ));
+            if (normals) {
+                float nx, ny, nz;
+                lightmap.normal(x, z, nx, ny, nz);
+                glNormal3f(nx, ny, nz);
+            }
+            if (baked || splatted) {
+                float r = 1.f, g = 1.f, b = 1.f;
+                if (splatted) {
+                    splat.colour(x, z, r, g, b);
+                }
+                auto light = baked ? lightmap.light(x, z) : 1.f;
+                glColor3f(r * light, g * light, b * light);
+            }
+        }
+        glVertex3f(v.x, v.y, v.z);
+    };
+
+    for (size_t i = 0; i + 2 < terrainIndices.size(); i += 3) {
+        const auto &first  = terrainVertices[terrainIndices[i]];
+        const auto &second = terrainVertices[terrainIndices[i + 1]];
+        const auto &third  = terrainVertices[terrainIndices[i + 2]];
         glBindTexture(GL_TEXTURE_2D, TextureID);
         if (!wireframe) {
             glBegin(GL_TRIANGLES);
@@ -78,24 +263,26 @@ void Terrain::render(bool wireframe) {
             glBegin(GL_LINE_LOOP);
         }
 
-        auto normal = -glm::triangleNormal(tri.first, tri.second, tri.third);
-        glNormal3f(normal.x, normal.y, normal.z);
+        if (!baked && !normals) {
+            auto normal = glm::triangleNormal(first, second, third);
+            glNormal3f(normal.x, normal.y, normal.z);
+        }
 
         // calculate the texture coordinates
         if (count % 2 != 0) {
             glTexCoord2f(0, 0);
-            glVertex3f(tri.first.x, tri.first.y, tri.first.z);
+            vertex(first);
             glTexCoord2f(1, 0);
-            glVertex3f(tri.second.x, tri.second.y, tri.second.z);
+            vertex(second);
             glTexCoord2f(0, 1);
-            glVertex3f(tri.third.x, tri.third.y, tri.third.z);
+            vertex(third);
         } else {
             glTexCoord2f(1, 0);
-            glVertex3f(tri.first.x, tri.first.y, tri.first.z);
+            vertex(first);
             glTexCoord2f(0, 1);
-            glVertex3f(tri.second.x, tri.second.y, tri.second.z);
+            vertex(second);
             glTexCoord2f(0, 1);
-            glVertex3f(tri.third.x, tri.third.y, tri.third.z);
+            vertex(third);
         }
 
         count++;
@@ -103,6 +290,14 @@ void Terrain::render(bool wireframe) {
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
+    if (baked || splatted) {
+        glPopAttrib();
+    }
+
+    for (auto &scatter : scatters) {
+        scatter.render();
+    }
+
     // for (size_t z = 0; z < terrainData.size() - 1; z++) {
     //    for (size_t x = 0; x < terrainData.size() - 1; x++) {
 
@@ -135,6 +330,14 @@ void Terrain::render(bool wireframe) {
     //}
 }
 
+void Terrain::shutdown() {
+    textures.shutdown();
+    TextureID = 0;
+    for (auto &scatter : scatters) {
+        scatter.shutdown();
+    }
+}
+
 bool Terrain::loadHeightfield(const std::string filename, const int size) {
     std::ifstream infile(filename, std::ios::binary);
 
@@ -143,10 +346,9 @@ bool Terrain::loadHeightfield(const std::string filename, const int size) {
         return false;
     }
 
-    if (!terrainData.empty()) {
-        terrainData.clear();
-    }
-    terrainData.resize(size);
+    stopProgressive();
+    terrainData.clear();
+    heightfieldFile = filename;
 
     if (size > 0) {
         infile.seekg(0, std::ios::end);
@@ -158,14 +360,17 @@ bool Terrain::loadHeightfield(const std::string filename, const int size) {
         }
         infile.seekg(0, std::ios::beg);
 
+        scratch.reset();
+        auto count   = static_cast<size_t>(size) * size;
+        auto heights = scratch.allocate<float>(count);
         char c;
-        for (auto y = 0; y < size; y++) {
-            for (auto x = 0; x < size; x++) {
-                infile.get(c);
-                unsigned char vert = c;
-                terrainData.at(y).push_back(vert - 128);
-            }
+        for (size_t i = 0; i < count; i++) {
+            infile.get(c);
+            unsigned char vert = c;
+            heights[i]         = vert - 128;
         }
+        transpose(heights, size);
+        terrainData.assign(heights, size);
     }
     imageSize = size;
     return true;
@@ -174,68 +379,68 @@ bool Terrain::loadHeightfield(const std::string filename, const int size) {
 void Terrain::readTerrainData() {
     for (auto y = 0; y < imageSize; y++) {
         for (auto x = 0; x < imageSize; x++) {
-            std::cout << terrainData.at(x).at(y) << ',';
+            std::cout << terrainData.get(x, y) << ',';
         }
-        std::cout << std::endl;
+        std::cout << '\n';
     }
+    std::cout.flush();
+}
+
+bool Terrain::exportHeightfield(const std::string &filename) {
+    MeshExport::Format format;
+    if (!MeshExport::formatFromPath(filename, format)) {
+        std::cerr << "Unknown mesh format :" << filename << std::endl;
+        return false;
+    }
+    // rows are dequantized on demand, so only the blocks in flight are
+    // expanded to floats
+    auto rows = [this](int z, float *heights) {
+        terrainData.readRow(z, 0, terrainData.size(), heights);
+    };
+    MeshExport::Stats stats;
+    if (!MeshExport::writeHeightfield(filename, format, terrainData.size(),
+                                      rows, spacingX(), scaleY, spacingZ(),
+                                      stats)) {
+        return false;
+    }
+    std::cout << "Exported " << filename << " at "
+              << stats.megabytesPerSecond() << " MB/s" << std::endl;
+    return true;
+}
+
+bool Terrain::exportMesh(const std::string &filename) {
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float),
+                  "vertices must be packed xyz");
+    MeshExport::Format format;
+    if (!MeshExport::formatFromPath(filename, format)) {
+        std::cerr << "Unknown mesh format :" << filename << std::endl;
+        return false;
+    }
+    MeshExport::Stats stats;
+    if (!MeshExport::writeIndexed(
+            filename, format,
+            reinterpret_cast<const float *>(terrainVertices.data()),
+            terrainVertices.size(), terrainIndices.data(),
+            terrainIndices.size() / 3, stats)) {
+        return false;
+    }
+    std::cout << "Exported " << filename << " at "
+              << stats.megabytesPerSecond() << " MB/s" << std::endl;
+    return true;
 }
 
 
 
 void Terrain::filterPass(float *dataP, int increment, float weight) {
-    float yprev = *dataP;    // the starting point in the terrain array
-    int j       = increment; // +1, -1, +size, -size
-    float k     = weight;
-    // loop through either
-    // one row from left to right (increment = +1), or
-    // one row from right to left (increment = -1), or
-    // one column from top to bottom (increment = +size), or
-    // one column from bottom to top (increment = -size)
-    for (int i = 1; i < imageSize; i++) {
-        // yi           = k yi - 1 + (1 - k) xi;
-        *(dataP + j) = k * yprev + (1 - k) * (*(dataP + j)); //
-        yprev        = *(dataP + j);
-        j += increment;
-    }
+    TerrainKernels::filterPass(dataP, increment, weight, imageSize);
 }
 
 void Terrain::addFilter(float *heights, float weight) {
-    int i;
-    // erode left to right, starting at the beginning of each row
-    for (i = 0; i < imageSize; i++)
-        filterPass(&heights[imageSize * i], 1, weight);
-    // erode right to left, starting at the end of each row
-    for (i = 0; i < imageSize; i++)
-        filterPass(&heights[imageSize * i + imageSize - 1], -1, weight);
-    // erode top to bottom, starting at the beginning of each column
-    for (i = 0; i < imageSize; i++)
-        filterPass(&heights[i], imageSize, weight);
-    // erode from bottom to top, starting from the end of each column
-    for (i = 0; i < imageSize; i++)
-        filterPass(&heights[imageSize * (imageSize - 1) + i], -imageSize, weight);
+    TerrainKernels::addFilter(heights, weight, imageSize);
 }
 
 void Terrain::normaliseTerrain(float *heights) {
-    float fMin, fMax;
-    float fHeight;
-    int i;
-    fMin = heights[0];
-    fMax = heights[0];
-    // find the min/max values of the height terrainData
-    for (i = 1; i < imageSize * imageSize; i++) {
-        if (heights[i] > fMax)
-            fMax = heights[i];
-        else if (heights[i] < fMin)
-            fMin = heights[i];
-    }
-    // find the range of the altitude
-    if (fMax <= fMin)
-        return;
-    fHeight = fMax - fMin;
-    // scale the values to a range of 0-255
-    for (i = 0; i < imageSize * imageSize; i++) {
-        heights[i] = ((heights[i] - fMin) / fHeight) * 255.0f;
-    }
+    TerrainKernels::normalise(heights, imageSize);
 }
 
 bool Terrain::genFaultFormation(int iterations, int hSize, int minHeight,
@@ -248,18 +453,18 @@ bool Terrain::genFaultFormation(int iterations, int hSize, int minHeight,
         return false;
     if (random) // create truly random map
         srand(time(NULL));
+    stopProgressive();
+    heightfieldFile.clear();
     // allocate memory for heightfield array
     imageSize      = hSize;
     size_t size    = imageSize;
     auto arraySize = size * size;
-    heights        = new float[arraySize]; // allocate memory
+    // reuse the scratch memory from the previous run
+    scratch.reset();
+    heights = scratch.allocate<float>(arraySize);
 
-    if (heights == nullptr)
-        return false;
     // initialise the heightfield array to all zeros
-    for (int i = 0; i < arraySize; i++) {
-        heights[i] = 0.0;
-    }
+    std::fill(heights, heights + arraySize, 0.f);
 
     // generate heightfield
     for (int j = 0; j < iterations; j++) {
@@ -274,15 +479,9 @@ bool Terrain::genFaultFormation(int iterations, int hSize, int minHeight,
             x2 = (rand() % size);
             z2 = (rand() % size);
         } while (x2 == x1 && z2 == z1);
-        // for each point P(x, z) in the field, calculate the new height values
-        for (int z = 0; z < size; z++) {
-            for (int x = 0; x < size; x++) {
-                // determine which side of the line P1P2 the point P lies in
-                if (((x - x1) * (z2 - z1) - (x2 - x1) * (z - z1)) > 0) {
-                    heights[(z * size) + x] += (float)displacement;
-                }
-            }
-        }
+        // raise every point P(x, z) on one side of the line P1P2
+        TerrainKernels::applyFault(heights, imageSize, x1, z1, x2, z2,
+                                   static_cast<float>(displacement));
         addFilter(heights, weight);
     }
     for (auto i = 0; i < postSmoothingIterations; i++) {
@@ -291,35 +490,87 @@ bool Terrain::genFaultFormation(int iterations, int hSize, int minHeight,
 
     // normalise the heightfield
     normaliseTerrain(heights);
-    // copy the float heightfield to terrainData (in unsign char)
+    // copy the float heightfield to terrainData, reusing any unshared tiles
+    transpose(heights, imageSize);
+    terrainData.assign(heights, imageSize);
+    return true;
+}
 
-    // initialise the heightfield array to all zeros
-    for (auto y = 0; terrainData.size() < size; y++) {
-        std::vector<float> axis;
-        for (int i = 0; i < size; i++) {
-            axis.push_back(0.0);
-        }
-        terrainData.push_back(axis);
-    }
+void Terrain::genFaultFormationProgressive(int iterations, int hSize,
+                                           int minHeight, int maxHeight,
+                                           float weight,
+                                           int postSmoothingIterations,
+                                           bool random) {
+    ProgressiveGenerator::Parameters parameters;
+    parameters.iterations              = iterations;
+    parameters.size                    = hSize;
+    parameters.minHeight               = minHeight;
+    parameters.maxHeight               = maxHeight;
+    parameters.weight                  = weight;
+    parameters.postSmoothingIterations = postSmoothingIterations;
+    parameters.random                  = random;
+    heightfieldFile.clear();
+    stretch = 1.f;
+    progressive.start(parameters);
+}
 
-    for (size_t z = 0; z < size; z++) {
-        for (size_t x = 0; x < size; x++) {
-            size_t place            = (z * size) + x;
-            terrainData.at(z).at(x) = ((heights[place]));
-        }
+bool Terrain::updateProgressive() {
+    auto storage = terrainData.storage();
+    if (!progressive.poll(terrainData)) {
+        return false;
     }
-
-    // dispose of the temporary array heights
-    delete[] heights;
+    terrainData.setStorage(storage);
+    imageSize = terrainData.size();
+
+    // stretch coarse levels over the same area as the final terrain, the
+    // last level has the target size and so a stretch of one
+    auto target = progressive.targetSize();
+    stretch     = imageSize > 1 ? (target - 1.f) / (imageSize - 1.f) : 1.f;
+    createTriangles();
     return true;
 }
 
+void Terrain::stopProgressive() {
+    progressive.cancel();
+    stretch = 1.f;
+}
+
+float Terrain::spacingX() const {
+    return scaleX * stretch;
+}
+
+float Terrain::spacingZ() const {
+    return scaleZ * stretch;
+}
+
 void Terrain::flatTerrain(int size) {
-    terrainData.clear();
+    stopProgressive();
+    heightfieldFile.clear();
     terrainData.resize(size);
-    for (auto n : terrainData) {
-        for (auto i = 0; i < terrainData.size(); i++) {
-            terrainData.at(i).push_back(0.f);
-        }
+    imageSize = size;
+}
+
+void Terrain::beginEdit() {
+    history.push(terrainData);
+}
+
+bool Terrain::undo() {
+    stopProgressive();
+    if (!history.undo(terrainData)) {
+        return false;
     }
+    // the snapshot may be a different size and the mesh is of the old state
+    imageSize = terrainData.size();
+    createTriangles();
+    return true;
+}
+
+bool Terrain::redo() {
+    stopProgressive();
+    if (!history.redo(terrainData)) {
+        return false;
+    }
+    imageSize = terrainData.size();
+    createTriangles();
+    return true;
 }
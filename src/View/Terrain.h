@@ -1,37 +1,95 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <glm/vec3.hpp>
+#include "Engine/MemoryTracker.hpp"
 #include "Engine/OpenGL.hpp"
+#include "Engine/ScratchArena.hpp"
+#include "Heightfield.h"
+#include "Lightmap.h"
+#include "MeshSimplifier.h"
+#include "ProgressiveGenerator.h"
+#include "Scatter.h"
+#include "SplatMap.h"
+#include "TextureCache.h"
 class Terrain {
 
   public:
-    typedef struct triangle {
-        glm::vec3 first;
-        glm::vec3 second;
-        glm::vec3 third;
-    } triangle;
-
     Terrain();
-    std::vector<std::vector<float>> terrainData;
-    std::vector<triangle> terrainTri;
+    Heightfield terrainData;
+    // a vertex per grid sample the mesh uses and three indices per triangle,
+    // so neighbouring triangles share their corners
+    SDLEngine::TrackedVector<glm::vec3, SDLEngine::MemoryTag::Mesh> terrainVertices;
+    SDLEngine::TrackedVector<uint32_t, SDLEngine::MemoryTag::Mesh> terrainIndices;
 
     void createTriangles();
+    // largest vertical error allowed in the mesh, 0 builds the full grid
+    void setMaxMeshError(float maxError);
+    // light from a baked lightmap instead of GL lighting, rebaked with the
+    // mesh and cached beside a loaded heightfield
+    void setBakedLighting(bool enabled);
+    // blend material colours by height and slope, built with the mesh
+    void setSplatting(bool enabled);
+    // objects placed over the terrain whenever the mesh is built
+    void addScatter(const Scatter::Parameters &parameters);
+    void clearScatters();
+    size_t scatterInstances() const;
     bool loadHeightfield(const std::string filename, const int size);
     void readTerrainData();
+    // write the heightfield grid or the built mesh as .obj, .ply or .glb
+    bool exportHeightfield(const std::string &filename);
+    bool exportMesh(const std::string &filename);
     void render(bool wireframe);
+    // release the textures and display lists, before the GL context goes
+    void shutdown();
     bool genFaultFormation(int iterations, int hSize, int minHeight,
                            int maxHeight, float weight,int postSmoothingIterations, bool random);
+    void genFaultFormationProgressive(int iterations, int hSize, int minHeight,
+                                      int maxHeight, float weight,
+                                      int postSmoothingIterations, bool random);
+    bool updateProgressive();
     void flatTerrain(int size);
     void filterPass(float *dataP, int increment, float weight);
     void addFilter(float *terrainData, float weight);
     void normaliseTerrain(float *terrainData);
 
+    // snapshot the current heightfield before an edit so it can be undone
+    void beginEdit();
+    bool undo();
+    bool redo();
+
     GLuint TextureID;
 
   private:
+    void loadTexture();
+    void createSimplifiedTriangles();
+    void updateSurfaceMaps();
+    void bakeLighting(const float *heights, int size);
+    // cancel a background run before the terrain is replaced synchronously
+    void stopProgressive();
+    // distance between samples, the user's scale times any coarse stretch
+    float spacingX() const;
+    float spacingZ() const;
+
+    HeightfieldHistory history;
+    SDLEngine::ScratchArena scratch;
+    ProgressiveGenerator progressive;
+    MeshSimplifier simplifier;
+    std::vector<MeshSimplifier::Triangle> simplified;
+    float maxMeshError = 0.f;
+    Lightmap lightmap;
+    bool bakedLighting = false;
+    std::string heightfieldFile;
+    SplatMap splat;
+    bool splatting = false;
+    std::vector<Scatter> scatters;
+    TextureCache textures;
+    TextureCache::Handle terrainTexture = -1;
     int imageSize = 0;
     float scaleX  = 1;
     float scaleY  = 1;
     float scaleZ  = 1;
+    // coarse progressive levels are stretched over the final terrain's area
+    float stretch = 1;
 };
\ No newline at end of file
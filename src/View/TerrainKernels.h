@@ -0,0 +1,175 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Heightfield generation kernels templated on the sample type, so the
+ * same sweeps run over float and 16 bit quantized grids. Grids are square and
+ * row major.
+ */
+namespace TerrainKernels {
+
+    template <typename Sample>
+    struct SampleTraits;
+
+    template <>
+    struct SampleTraits<float> {
+        // normaliseTerrain scales float terrain to 0-255
+        static constexpr float range = 255.f;
+
+        static float load(float value) {
+            return value;
+        }
+        static float store(float value) {
+            return value;
+        }
+    };
+
+    template <>
+    struct SampleTraits<uint16_t> {
+        static constexpr float range = 65535.f;
+
+        static float load(uint16_t value) {
+            return value;
+        }
+        static uint16_t store(float value) {
+            return static_cast<uint16_t>(std::clamp(value, 0.f, range) + 0.5f);
+        }
+    };
+
+    /**
+     * @brief One pass of the exponential erosion filter along a single row or
+     * column, y(i) = k * y(i - 1) + (1 - k) * x(i)
+     * @param data The first sample of the row or column
+     * @param increment +1, -1, +size or -size
+     */
+    template <typename Sample>
+    void filterPass(Sample *data, int increment, float weight, int size) {
+        using Traits = SampleTraits<Sample>;
+        auto yprev   = Traits::load(*data);
+        auto j       = static_cast<std::ptrdiff_t>(increment);
+        for (int i = 1; i < size; i++) {
+            auto filtered = weight * yprev + (1 - weight) * Traits::load(data[j]);
+            data[j]       = Traits::store(filtered);
+            yprev         = Traits::load(data[j]);
+            j += increment;
+        }
+    }
+
+    /**
+     * @brief filterPass along a block of consecutive rows, left to right
+     * (direction +1) or right to left (direction -1). Each row is a serial
+     * recurrence, so several rows are swept together to overlap their
+     * dependency chains.
+     */
+    template <typename Sample>
+    void filterRows(Sample *heights, int direction, float weight, int size) {
+        using Traits         = SampleTraits<Sample>;
+        constexpr auto Lanes = 8;
+        auto start           = direction > 0 ? 0 : size - 1;
+        auto row = [&](int z) {
+            return heights + static_cast<size_t>(z) * size + start;
+        };
+        int z = 0;
+        for (; z + Lanes <= size; z += Lanes) {
+            Sample *rows[Lanes];
+            float yprev[Lanes];
+            for (int lane = 0; lane < Lanes; lane++) {
+                rows[lane]  = row(z + lane);
+                yprev[lane] = Traits::load(*rows[lane]);
+            }
+            for (int i = 1; i < size; i++) {
+                auto j = static_cast<std::ptrdiff_t>(i) * direction;
+                for (int lane = 0; lane < Lanes; lane++) {
+                    auto filtered = weight * yprev[lane] +
+                                    (1 - weight) * Traits::load(rows[lane][j]);
+                    rows[lane][j] = Traits::store(filtered);
+                    yprev[lane]   = Traits::load(rows[lane][j]);
+                }
+            }
+        }
+        for (; z < size; z++) {
+            filterPass(row(z), direction, weight, size);
+        }
+    }
+
+    /**
+     * @brief Filter one row into the row before it in the sweep direction.
+     * Every column of a vertical pass is independent, so sweeping a whole row
+     * at a time keeps the access contiguous and lets the loop vectorise.
+     */
+    template <typename Sample>
+    void filterRow(Sample *row, const Sample *previous, float weight,
+                   int size) {
+        using Traits = SampleTraits<Sample>;
+        for (int x = 0; x < size; x++) {
+            row[x] = Traits::store(weight * Traits::load(previous[x]) +
+                                   (1 - weight) * Traits::load(row[x]));
+        }
+    }
+
+    /**
+     * @brief Erode the heightfield left to right, right to left, top to bottom
+     * and bottom to top. Produces the same result as four filterPass sweeps
+     * over every row and column.
+     */
+    template <typename Sample>
+    void addFilter(Sample *heights, float weight, int size) {
+        auto row = [&](int z) {
+            return heights + static_cast<size_t>(z) * size;
+        };
+        filterRows(heights, 1, weight, size);
+        filterRows(heights, -1, weight, size);
+        for (int z = 1; z < size; z++) {
+            filterRow(row(z), row(z - 1), weight, size);
+        }
+        for (int z = size - 2; z >= 0; z--) {
+            filterRow(row(z), row(z + 1), weight, size);
+        }
+    }
+
+    /**
+     * @brief Scale the heightfield to the full range of the sample type,
+     * 0-255 for float terrain
+     */
+    template <typename Sample>
+    void normalise(Sample *heights, int size) {
+        using Traits = SampleTraits<Sample>;
+        auto count   = static_cast<size_t>(size) * size;
+        if (count == 0) {
+            return;
+        }
+        auto range = std::minmax_element(heights, heights + count);
+        auto fMin  = Traits::load(*range.first);
+        auto fMax  = Traits::load(*range.second);
+        if (fMax <= fMin) {
+            return;
+        }
+        auto fHeight = fMax - fMin;
+        for (size_t i = 0; i < count; i++) {
+            heights[i] = Traits::store(
+                ((Traits::load(heights[i]) - fMin) / fHeight) * Traits::range);
+        }
+    }
+
+    /**
+     * @brief Raise every sample on the positive side of the line P1P2 by
+     * displacement
+     */
+    template <typename Sample>
+    void applyFault(Sample *heights, int size, int x1, int z1, int x2, int z2,
+                    float displacement) {
+        using Traits = SampleTraits<Sample>;
+        auto dz      = z2 - z1;
+        for (int z = 0; z < size; z++) {
+            auto row    = heights + static_cast<size_t>(z) * size;
+            auto offset = -(x2 - x1) * (z - z1) - x1 * dz;
+            for (int x = 0; x < size; x++) {
+                if (x * dz + offset > 0) {
+                    row[x] = Traits::store(Traits::load(row[x]) + displacement);
+                }
+            }
+        }
+    }
+}
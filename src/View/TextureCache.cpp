@@ -0,0 +1,300 @@
+#include "TextureCache.h"
+
+#include <SDL_image.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "Engine/ParallelFor.hpp"
+#include "Engine/Utility.hpp"
+
+namespace {
+    constexpr int CHANNELS = 4;
+    constexpr int ROWS_PER_TASK = 32;
+
+    constexpr char CACHE_MAGIC[4]    = {'T', 'M', 'I', 'P'};
+    constexpr uint32_t CACHE_VERSION = 1;
+    // larger than any texture GL will take, so bigger sizes mean a bad file
+    constexpr int32_t MAX_CACHE_SIZE = 16384;
+
+    uint64_t fileKey(const std::vector<char> &bytes) {
+        auto hash = SDLEngine::FNV_OFFSET_BASIS;
+        for (auto byte : bytes) {
+            hash = SDLEngine::fnv1a(hash, static_cast<unsigned char>(byte));
+        }
+        return hash;
+    }
+}
+
+TextureCache::TextureCache() {
+    // initialise the decoders up front, not lazily from the workers
+    IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG);
+}
+
+TextureCache::~TextureCache() {
+    for (auto &entry : entries) {
+        if (entry->worker.joinable()) {
+            entry->worker.join();
+        }
+    }
+}
+
+void TextureCache::shutdown() {
+    for (auto &entry : entries) {
+        if (entry->id != 0) {
+            glDeleteTextures(1, &entry->id);
+            SDLEngine::MemoryTracker::freed(SDLEngine::MemoryTag::Textures,
+                                            entry->bytes);
+            entry->id    = 0;
+            entry->bytes = 0;
+        }
+    }
+}
+
+TextureCache::Handle TextureCache::request(const std::string &filename) {
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i]->filename == filename) {
+            return static_cast<Handle>(i);
+        }
+    }
+
+    entries.push_back(std::make_unique<Entry>());
+    auto entry      = entries.back().get();
+    entry->filename = filename;
+    pending++;
+    entry->worker = std::thread([entry] {
+        entry->failed = !decode(entry->filename, entry->levels);
+        entry->decoded.store(true, std::memory_order_release);
+    });
+    return static_cast<Handle>(entries.size() - 1);
+}
+
+void TextureCache::upload() {
+    if (pending.load() == 0) {
+        return;
+    }
+    for (auto &entry : entries) {
+        if (!entry->decoded.load(std::memory_order_acquire) ||
+            !entry->worker.joinable()) {
+            continue;
+        }
+        entry->worker.join();
+        pending--;
+        if (entry->failed) {
+            continue;
+        }
+
+        glGenTextures(1, &entry->id);
+        glBindTexture(GL_TEXTURE_2D, entry->id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (size_t level = 0; level < entry->levels.size(); level++) {
+            const auto &mip = entry->levels[level];
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GL_RGBA,
+                         mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         mip.pixels.data());
+            entry->bytes += mip.pixels.size();
+        }
+        // the GL copy, assuming the driver keeps RGBA8 as given
+        SDLEngine::MemoryTracker::allocated(SDLEngine::MemoryTag::Textures,
+                                            entry->bytes);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                        GL_LINEAR_MIPMAP_LINEAR);
+        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // GL has its own copy now
+        std::vector<MipLevel>().swap(entry->levels);
+    }
+}
+
+GLuint TextureCache::textureID(Handle handle) const {
+    if (handle < 0 || handle >= static_cast<Handle>(entries.size())) {
+        return 0;
+    }
+    return entries[handle]->id;
+}
+
+bool TextureCache::decode(const std::string &filename,
+                          std::vector<MipLevel> &levels) {
+    std::ifstream infile(filename, std::ios::binary);
+    if (!infile) {
+        std::cerr << "Cannot open file :" << filename << std::endl;
+        return false;
+    }
+    std::vector<char> bytes((std::istreambuf_iterator<char>(infile)),
+                            std::istreambuf_iterator<char>());
+
+    auto key       = fileKey(bytes);
+    auto cacheFile = filename + ".mips";
+    if (loadCache(cacheFile, key, levels)) {
+        return true;
+    }
+
+    // decode from the bytes already read rather than opening the file again
+    auto surface = IMG_Load_RW(
+        SDL_RWFromConstMem(bytes.data(), static_cast<int>(bytes.size())), 1);
+    if (surface == nullptr) {
+        std::cerr << "Cannot decode image :" << filename << " "
+                  << IMG_GetError() << std::endl;
+        return false;
+    }
+    if (surface->format->format != SDL_PIXELFORMAT_RGBA32) {
+        auto converted =
+            SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_FreeSurface(surface);
+        surface = converted;
+        if (surface == nullptr) {
+            std::cerr << "Cannot convert image :" << filename << " "
+                      << SDL_GetError() << std::endl;
+            return false;
+        }
+    }
+
+    levels.assign(1, MipLevel{});
+    auto &base  = levels.front();
+    base.width  = surface->w;
+    base.height = surface->h;
+    base.pixels.resize(static_cast<size_t>(base.width) * base.height *
+                       CHANNELS);
+    auto rowBytes = static_cast<size_t>(base.width) * CHANNELS;
+    for (int y = 0; y < base.height; y++) {
+        std::memcpy(base.pixels.data() + y * rowBytes,
+                    static_cast<const uint8_t *>(surface->pixels) +
+                        static_cast<size_t>(y) * surface->pitch,
+                    rowBytes);
+    }
+    SDL_FreeSurface(surface);
+
+    buildMipChain(levels);
+    saveCache(cacheFile, key, levels);
+    return true;
+}
+
+void TextureCache::buildMipChain(std::vector<MipLevel> &levels) {
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const auto &source = levels.back();
+        MipLevel mip;
+        mip.width  = std::max(source.width / 2, 1);
+        mip.height = std::max(source.height / 2, 1);
+        mip.pixels.resize(static_cast<size_t>(mip.width) * mip.height *
+                          CHANNELS);
+
+        // 2x2 box filter, odd edges reuse the last row or column
+        SDLEngine::parallelFor(
+            mip.height, ROWS_PER_TASK, [&](size_t begin, size_t end) {
+                for (auto y = begin; y < end; y++) {
+                    auto y0     = std::min<size_t>(y * 2, source.height - 1);
+                    auto y1     = std::min<size_t>(y * 2 + 1, source.height - 1);
+                    auto stride = static_cast<size_t>(source.width) * CHANNELS;
+                    auto row0   = source.pixels.data() + y0 * stride;
+                    auto row1   = source.pixels.data() + y1 * stride;
+                    auto out    = mip.pixels.data() + y * mip.width * CHANNELS;
+                    for (int x = 0; x < mip.width; x++) {
+                        auto last = source.width - 1;
+                        auto x0   = std::min(x * 2, last) * CHANNELS;
+                        auto x1   = std::min(x * 2 + 1, last) * CHANNELS;
+                        for (int c = 0; c < CHANNELS; c++) {
+                            out[x * CHANNELS + c] = static_cast<uint8_t>(
+                                (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] +
+                                 row1[x1 + c] + 2) /
+                                4);
+                        }
+                    }
+                }
+            });
+        levels.push_back(std::move(mip));
+    }
+}
+
+bool TextureCache::loadCache(const std::string &filename, uint64_t key,
+                             std::vector<MipLevel> &levels) {
+    std::ifstream infile(filename, std::ios::binary | std::ios::ate);
+    if (!infile) {
+        return false;
+    }
+    auto remaining = static_cast<uint64_t>(infile.tellg());
+    infile.seekg(0);
+
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t stored  = 0;
+    uint32_t count   = 0;
+    infile.read(magic, sizeof(magic));
+    infile.read(reinterpret_cast<char *>(&version), sizeof(version));
+    infile.read(reinterpret_cast<char *>(&stored), sizeof(stored));
+    infile.read(reinterpret_cast<char *>(&count), sizeof(count));
+    if (!infile || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+        version != CACHE_VERSION || stored != key || count == 0 || count > 32) {
+        return false;
+    }
+
+    remaining -= sizeof(magic) + sizeof(version) + sizeof(stored) +
+                 sizeof(count);
+
+    // check every size before allocating for it: the base level within
+    // bounds, each level after it half the one before down to 1x1, and the
+    // pixels actually in the file. A bad cache is decoded again instead.
+    levels.assign(count, MipLevel{});
+    for (uint32_t i = 0; i < count; i++) {
+        auto &mip       = levels[i];
+        int32_t size[2] = {0, 0};
+        infile.read(reinterpret_cast<char *>(size), sizeof(size));
+        auto valid = static_cast<bool>(infile);
+        if (i == 0) {
+            valid = valid && size[0] > 0 && size[1] > 0 &&
+                    size[0] <= MAX_CACHE_SIZE && size[1] <= MAX_CACHE_SIZE;
+        } else {
+            const auto &previous = levels[i - 1];
+            valid = valid && size[0] == std::max(previous.width / 2, 1) &&
+                    size[1] == std::max(previous.height / 2, 1);
+        }
+        auto bytes = static_cast<uint64_t>(std::max(size[0], 0)) *
+                     std::max(size[1], 0) * CHANNELS;
+        valid = valid && remaining >= sizeof(size) + bytes;
+        if (!valid) {
+            levels.clear();
+            return false;
+        }
+        remaining -= sizeof(size) + bytes;
+
+        mip.width  = size[0];
+        mip.height = size[1];
+        mip.pixels.resize(static_cast<size_t>(bytes));
+        infile.read(reinterpret_cast<char *>(mip.pixels.data()),
+                    mip.pixels.size());
+    }
+    const auto &last = levels.back();
+    if (!infile || last.width != 1 || last.height != 1) {
+        levels.clear();
+        return false;
+    }
+    return true;
+}
+
+bool TextureCache::saveCache(const std::string &filename, uint64_t key,
+                             const std::vector<MipLevel> &levels) {
+    std::ofstream outfile(filename, std::ios::binary);
+    if (!outfile) {
+        std::cerr << "Cannot open file :" << filename << std::endl;
+        return false;
+    }
+
+    auto count = static_cast<uint32_t>(levels.size());
+    outfile.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    outfile.write(reinterpret_cast<const char *>(&CACHE_VERSION),
+                  sizeof(CACHE_VERSION));
+    outfile.write(reinterpret_cast<const char *>(&key), sizeof(key));
+    outfile.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    for (const auto &mip : levels) {
+        int32_t size[2] = {mip.width, mip.height};
+        outfile.write(reinterpret_cast<const char *>(size), sizeof(size));
+        outfile.write(reinterpret_cast<const char *>(mip.pixels.data()),
+                      mip.pixels.size());
+    }
+    return static_cast<bool>(outfile);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Engine/MemoryTracker.hpp"
+#include "Engine/OpenGL.hpp"
+
+/**
+ * @brief Loads textures off the render thread. request() decodes the image
+ * and builds its full mip chain on a worker thread, then upload() hands the
+ * finished chains to GL on the render thread. Processed chains are cached on
+ * disk beside the image as <image>.mips, keyed by a hash of the image file,
+ * so later runs skip decoding and filtering entirely.
+ */
+class TextureCache {
+
+  public:
+    using Handle = int;
+
+    TextureCache();
+    TextureCache(const TextureCache &) = delete;
+    TextureCache &operator=(const TextureCache &) = delete;
+    ~TextureCache();
+
+    // returns the same handle for repeated requests of one file
+    Handle request(const std::string &filename);
+    // render thread only, uploads every chain finished since the last call
+    void upload();
+    // 0 until the texture has been uploaded
+    GLuint textureID(Handle handle) const;
+    // render thread only, deletes every uploaded texture while the context
+    // still exists; the destructor makes no GL calls
+    void shutdown();
+
+  private:
+    struct MipLevel {
+        int width  = 0;
+        int height = 0;
+        SDLEngine::TrackedVector<uint8_t, SDLEngine::MemoryTag::Textures> pixels;
+    };
+
+    struct Entry {
+        std::string filename;
+        std::vector<MipLevel> levels;
+        std::atomic<bool> decoded{false};
+        bool failed = false;
+        GLuint id   = 0;
+        // accounted to MemoryTag::Textures while the texture exists
+        size_t bytes = 0;
+        std::thread worker;
+    };
+
+    static bool decode(const std::string &filename,
+                       std::vector<MipLevel> &levels);
+    static void buildMipChain(std::vector<MipLevel> &levels);
+    static bool loadCache(const std::string &filename, uint64_t key,
+                          std::vector<MipLevel> &levels);
+    static bool saveCache(const std::string &filename, uint64_t key,
+                          const std::vector<MipLevel> &levels);
+
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::atomic<int> pending{0};
+};